@@ -61,7 +61,7 @@ void Buffer::EnsureWritable(size_t const len){
     if(len > WritableBytes())
         MakeSpace_(len);
     
-    assert(len < WritableBytes());      // 腾出的空间肯定比要写的空间大
+    assert(len <= WritableBytes());     // 腾出的空间至少和要写的一样大
 }
 
 // 写指针移动指定位置
@@ -0,0 +1,109 @@
+#include "capture.h"
+#include <chrono>
+#include <cstring>
+
+bool Capture::is_open_ = false;
+
+static int64_t MonoUs(){
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+Capture::Capture() :
+    next_conn_(0),
+    bytes_(0),
+    fp_(nullptr),
+    last_us_(0)
+{
+
+}
+
+Capture::~Capture(){
+    Close();
+}
+
+Capture& Capture::Instance(){
+    static Capture ins;
+    return ins;
+}
+
+bool Capture::Init(const std::string& file){
+    std::lock_guard<std::mutex> lck(mtx_);
+    if(fp_)
+        return true;
+    fp_ = fopen(file.c_str(), "wb");
+    if(!fp_)
+        return false;
+    setvbuf(fp_, nullptr, _IOFBF, 1 << 20);
+
+    int64_t start_us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    char head[16];
+    memcpy(head, CAPTURE_MAGIC, sizeof(CAPTURE_MAGIC));
+    for(int i = 0; i < 8; ++i)
+        head[8 + i] = (char)((uint64_t)start_us >> (8 * i));
+    fwrite(head, 1, sizeof(head), fp_);
+    last_us_ = MonoUs();
+    is_open_ = true;
+    return true;
+}
+
+void Capture::Close(){
+    std::lock_guard<std::mutex> lck(mtx_);
+    is_open_ = false;
+    if(fp_){
+        fclose(fp_);
+        fp_ = nullptr;
+    }
+}
+
+char* Capture::PutVarint(char* p, uint64_t value){
+    while(value >= 0x80){
+        *p++ = (char)(value | 0x80);
+        value >>= 7;
+    }
+    *p++ = (char)value;
+    return p;
+}
+
+void Capture::Write(uint8_t type, uint64_t conn, const char* data, std::size_t len){
+    char head[1 + 10 * 3];
+    std::lock_guard<std::mutex> lck(mtx_);
+    if(!fp_)
+        return;
+    int64_t now_us = MonoUs();
+    char* p = head;
+    *p++ = (char)type;
+    p = PutVarint(p, now_us - last_us_);
+    p = PutVarint(p, conn);
+    if(type == CAP_DATA)
+        p = PutVarint(p, len);
+    last_us_ = now_us;
+    fwrite(head, 1, p - head, fp_);
+    if(len > 0)
+        fwrite(data, 1, len, fp_);
+}
+
+// 返回新连接的连接号
+uint64_t Capture::Open(){
+    uint64_t conn = next_conn_.fetch_add(1) + 1;
+    Write(CAP_OPEN, conn, nullptr, 0);
+    return conn;
+}
+
+void Capture::Data(uint64_t conn, const char* data, std::size_t len){
+    if(len == 0)
+        return;
+    bytes_.fetch_add(len, std::memory_order_relaxed);
+    Write(CAP_DATA, conn, data, len);
+}
+
+void Capture::Closed(uint64_t conn, bool by_peer){
+    Write(by_peer ? CAP_PEER_CLOSE : CAP_CLOSE, conn, nullptr, 0);
+}
+
+uint64_t Capture::GetBytes() const {
+    return bytes_.load(std::memory_order_relaxed);
+}
+
+uint64_t Capture::GetConns() const {
+    return next_conn_.load(std::memory_order_relaxed);
+}
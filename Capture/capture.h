@@ -0,0 +1,58 @@
+#ifndef CAPTURE_H
+#define CAPTURE_H
+#include "nocopy.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+
+// 抓包文件格式，整数都是小端:
+//   文件头: "TWCAP1\n\0"，8字节开始时间(Unix微秒)
+//   记录:   1字节类型，varint距上一条记录的微秒数，varint连接号，CAP_DATA再跟varint长度和原始字节
+// 连接号在一次抓包中唯一，不会像fd一样被复用
+constexpr char CAPTURE_MAGIC[8] = { 'T', 'W', 'C', 'A', 'P', '1', '\n', '\0' };
+
+enum CAPTURE_RECORD{
+    CAP_OPEN = 1,           // 新连接
+    CAP_DATA = 2,           // 从连接读到的请求字节
+    CAP_CLOSE = 3,          // 服务器关闭连接，例如达到keep-alive请求数上限或者超时
+    CAP_PEER_CLOSE = 4      // 客户端先关闭了连接
+};
+
+// 在HttpConn::read的边界记录原始请求字节、时间和连接号，用bench/replay按原来的节奏回放。
+// 多个线程的记录用一把锁串行写入带缓冲的文件，只在抓包时使用，不开启时只多一次判断
+class Capture : public NoCopy{
+public:
+    static Capture& Instance();
+
+    bool Init(const std::string& file);
+    void Close();
+    static bool IsOpen(){
+        return is_open_;
+    }
+
+    uint64_t Open();
+    void Data(uint64_t conn, const char* data, std::size_t len);
+    void Closed(uint64_t conn, bool by_peer);
+    uint64_t GetBytes() const;
+    uint64_t GetConns() const;
+
+private:
+    Capture();
+    ~Capture();
+    void Write(uint8_t type, uint64_t conn, const char* data, std::size_t len);
+    static char* PutVarint(char* p, uint64_t value);
+
+private:
+    static bool is_open_;
+    std::atomic<uint64_t> next_conn_;
+    std::atomic<uint64_t> bytes_;           // 记录的请求字节数
+
+    std::mutex mtx_;
+    FILE* fp_;
+    int64_t last_us_;               // 上一条记录的时间，在锁内取时间保证间隔不为负
+};
+
+#endif
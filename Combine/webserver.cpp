@@ -1,25 +1,45 @@
 #include "webserver.h"
+#include <algorithm>
 #include <asm-generic/socket.h>
 #include <cassert>
 #include <cerrno>
 #include <cstring>
+#include <ctime>
 #include <fcntl.h>
 #include <functional>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <sched.h>
 #include <sys/epoll.h>
 #include <sys/socket.h>
 #include <unistd.h>
 #include "../Pool/sqlconnpool.h"
+#include "../Pool/sqlexecutor.h"
+#include "../Pool/registerbuffer.h"
+#include "../Pool/userfilter.h"
+#include "../Http/sessionstore.h"
+#include "../Http/filecache.h"
 #include <arpa/inet.h>
+#include <csignal>
 #include "../Log/log.h"
 #include "../Pool/threadpool.h"
+#include "topology.h"
+#include "../Metrics/metrics.h"
+#include "../Trace/trace.h"
+#include "../Capture/capture.h"
+#include "../Metrics/accounting.h"
+#include "../Epoller/uringpoller.h"
 
 
 WebServer::WebServer(int port, int trig_mode, int time_out_ms, bool opt_linger,
             int sql_port, const char* sql_user, const char* sql_pwd, const char* db_name, int conn_pool_num, 
-            bool open_log, int log_level, int log_que_size) :
-            port_(port), opt_linger_(opt_linger), time_out_ms_(time_out_ms), is_close_(false),
-            timer_(new HeapTimer), epoller_(new Epoller), src_dir_(nullptr)
+            bool open_log, int log_level, int log_que_size, const ServerOptions& options) :
+            port_(port), opt_linger_(opt_linger), time_out_ms_(time_out_ms), header_timeout_ms_(0), tick_ms_(-1), is_close_(false),
+            listen_fd_(-1), reserve_fd_(-1), listen_pending_(false), src_dir_(nullptr), options_(options),
+            is_owned_(false), saved_ctl_(0),
+            spin_ns_(0), work_ns_(0), spin_hit_(0), spin_miss_(0),
+            timer_(new HeapTimer), epoller_(nullptr), uring_(nullptr)
 {
 
      // 是否打开日志
@@ -39,6 +59,13 @@ WebServer::WebServer(int port, int trig_mode, int time_out_ms, bool opt_linger,
         }
     }
 
+    // 创建I/O后端
+    epoller_.reset(Poller::Create(options_.io_backend));
+    if(options_.io_backend == BACKEND_URING && options_.uring_io){
+        uring_ = dynamic_cast<UringPoller*>(epoller_.get());         // 退回epoll时为空
+    }
+    LOG_INFO("IO Backend: %s%s", epoller_->Name(), uring_ ? " (completion)" : "");
+
     // 前端文件存放位置
     src_dir_ = getcwd(nullptr, 256);
     assert(src_dir_);
@@ -48,8 +75,54 @@ WebServer::WebServer(int port, int trig_mode, int time_out_ms, bool opt_linger,
     HttpConn::SetSrcDir(src_dir_);
     HttpConn::SetUserCount(0);
 
+    // 各阶段的超时，没有单独配置的使用time_out_ms。time_out_ms不大于0时不做超时处理
+    if(time_out_ms_ > 0){
+        header_timeout_ms_ = options_.header_timeout_ms > 0 ? options_.header_timeout_ms : time_out_ms_;
+        int body_ms = options_.body_timeout_ms > 0 ? options_.body_timeout_ms : time_out_ms_;
+        int idle_ms = options_.idle_timeout_ms > 0 ? options_.idle_timeout_ms : time_out_ms_;
+        int write_ms = options_.write_timeout_ms > 0 ? options_.write_timeout_ms : time_out_ms_;
+        HttpConn::SetTimeout(header_timeout_ms_, body_ms, idle_ms, write_ms);
+        tick_ms_ = std::min({header_timeout_ms_, body_ms, idle_ms, write_ms});
+    }
+    HttpConn::SetMaxRequests(options_.max_keep_alive_requests);
+    HttpConn::SetIoBudget(options_.io_budget_bytes);
+    HttpConn::SetRequestLimit(options_.max_header_bytes, options_.max_body_bytes);
+    HttpConn::SetMetrics(options_.metrics);
+    if(options_.trace){
+        Trace::Instance().Init(options_.trace_sample_n, options_.trace_slow_ms);
+        HttpConn::SetTraceDump(true);
+    }
+    if(options_.capture_file){
+        if(Capture::Instance().Init(options_.capture_file)){
+            LOG_INFO("Capture requests to %s", options_.capture_file);
+        }else{
+            LOG_ERROR("Capture file %s open error", options_.capture_file);
+        }
+    }
+
     // 初始化连接池
     SqlConnPool::Instance().Init("localhost", sql_port, sql_user, sql_pwd, db_name, conn_pool_num);
+    SqlExecutor::Instance().Init(conn_pool_num);        // 数据库线程，和连接池大小一致
+    if(options_.register_write_behind){
+        RegisterBuffer::Instance().Init(options_.register_batch_size, options_.register_flush_ms);
+    }
+    if(options_.user_filter){
+        UserFilter::Instance().Init(options_.user_filter_capacity, options_.user_filter_rebuild_ms);
+    }
+    if(options_.file_cache || options_.inline_static || uring_){         // 直接处理请求依赖文件缓存
+        FileCache::Instance().Init(options_.file_cache_max_file, options_.file_cache_capacity);
+    }
+    if(options_.session){
+        SessionStore::Instance().Init(options_.session_ttl_ms);
+        timer_->Add(SESSION_TIMER_ID, options_.session_sweep_ms, std::bind(&WebServer::SweepSession, this));
+    }
+
+    // 线程都创建好以后再绑定CPU
+    InitAffinity();
+
+    if(options_.metrics){
+        InitMetrics();
+    }
     
     // 设置事件触发模式
     InitEventMode(trig_mode);
@@ -62,9 +135,19 @@ WebServer::WebServer(int port, int trig_mode, int time_out_ms, bool opt_linger,
 
 WebServer::~WebServer(){
     close(listen_fd_);
+    if(reserve_fd_ >= 0)
+        close(reserve_fd_);
     is_close_ = true;
     free(src_dir_);
+    SqlExecutor::Instance().Close();
+    UserFilter::Instance().Close();
+    RegisterBuffer::Instance().Close();         // 把还没落库的注册写完再关闭连接池
     SqlConnPool::Instance().CloseSqlConnPool();
+    if(Capture::IsOpen()){          // 之后关闭的连接不再记录
+        LOG_INFO("Captured %llu connections, %llu bytes", (unsigned long long)Capture::Instance().GetConns(),
+                (unsigned long long)Capture::Instance().GetBytes());
+        Capture::Instance().Close();
+    }
 }
 
 void WebServer::InitEventMode(int trig_mode){
@@ -92,7 +175,13 @@ void WebServer::InitEventMode(int trig_mode){
     }
 
 
-    HttpConn::SetIsEt(conn_event_ | EPOLLET);
+    // 连接为ET时改用所有权模式：同时注册读写，不再使用EPOLLONESHOT
+    if(options_.conn_ownership && (conn_event_ & EPOLLET) && !uring_){         // io_uring完成模式不使用就绪事件
+        conn_event_ &= ~EPOLLONESHOT;
+        is_owned_ = true;
+    }
+
+    HttpConn::SetCork(options_.tcp_cork);
 }
 
 // 初始化socket
@@ -117,7 +206,7 @@ bool WebServer::InitSocket(){
         optLinger.l_linger = 1;         // 设置这个发送行为的超时时间为1s
     }
 
-    listen_fd_ = socket(AF_INET, SOCK_STREAM, 0);
+    listen_fd_ = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
     if(listen_fd_ < 0){
         LOG_ERROR("Create socket error! Port is: %d", port_);
         return false;
@@ -148,8 +237,26 @@ bool WebServer::InitSocket(){
         return false;
     }
 
-    // 监听socket，最大等待连接长度为6
-    ret = listen(listen_fd_, 6);
+    // 可选的TCP参数，设置失败不影响启动
+    if(options_.defer_accept_s > 0){            // 连接建立后等到第一个请求到达才通知，空连接不会唤醒事件循环
+        optval = options_.defer_accept_s;
+        if(setsockopt(listen_fd_, IPPROTO_TCP, TCP_DEFER_ACCEPT, &optval, sizeof(optval)) < 0){
+            LOG_WARN("set TCP_DEFER_ACCEPT error!");
+        }
+    }
+    if(options_.fastopen_qlen > 0){             // 客户端可以在SYN里带上请求
+        optval = options_.fastopen_qlen;
+        if(setsockopt(listen_fd_, IPPROTO_TCP, TCP_FASTOPEN, &optval, sizeof(optval)) < 0){
+            LOG_WARN("set TCP_FASTOPEN error!");
+        }
+    }
+
+    if(options_.so_busy_poll_us > 0){
+        SetBusyPoll(listen_fd_);
+    }
+
+    // 监听socket，等待队列长度由配置决定
+    ret = listen(listen_fd_, options_.listen_backlog);
     if(ret < 0){
         LOG_ERROR("Listen port:%d error!", port_);
         close(listen_fd_);
@@ -157,8 +264,8 @@ bool WebServer::InitSocket(){
     }
 
 
-    // 把设置好的端口放入epoll中，并且只有读事件通知
-    ret = epoller_->AddFd(listen_fd_, listen_event_ | EPOLLIN);
+    // 把设置好的端口放入epoll中，并且只有读事件通知。io_uring完成模式直接提交accept
+    ret = uring_ ? uring_->Accept(listen_fd_) : epoller_->AddFd(listen_fd_, listen_event_ | EPOLLIN);
     if(ret == false){
         LOG_ERROR("Add listen error!");
         close(listen_fd_);
@@ -167,27 +274,49 @@ bool WebServer::InitSocket(){
 
     // 设置socket为非阻塞模式
     SetFdNoBlock(listen_fd_);
-    LOG_INFO("Server port: %d", port_);
+
+    // 预留一个fd，进程的文件描述符用完时靠它把连接从队列里取出来拒绝掉
+    reserve_fd_ = open("/dev/null", O_RDONLY | O_CLOEXEC);
+    LOG_INFO("Server port: %d, backlog: %d", port_, options_.listen_backlog);
     return true;
 }
 
 // 设置socket为非阻塞
 int WebServer::SetFdNoBlock(int fd){
     assert(fd > 0);
-    return fcntl(fd, F_SETFL, fcntl(fd, F_GETFD, 0) | O_NONBLOCK);       // 获取当前socket文件描述符标志，并且添加非阻塞标志
+    return fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);       // 获取当前socket文件状态标志，并且添加非阻塞标志
 }
 
-// 发送错误，使用send方法
+// 发送错误后直接关闭。新连接的发送缓冲区是空的，不阻塞地发一次就够了，发不出去也不等待
 void WebServer::SendError(int fd, const char* info){
-    assert(fd > 0);
-    int ret = send(fd, info, strlen(info), 0);
+    assert(fd >= 0);
+    int ret = send(fd, info, strlen(info), MSG_DONTWAIT | MSG_NOSIGNAL);
     if(ret < 0){
         LOG_WARN("send error to client[%d] error!", fd);
     }
 
+    struct linger opt_linger{};         // 监听socket的SO_LINGER会被继承，关闭时不能阻塞事件循环
+    setsockopt(fd, SOL_SOCKET, SO_LINGER, &opt_linger, sizeof(opt_linger));
     close(fd);
 }
 
+// 文件描述符用完时accept一直失败，连接留在队列里，LT模式下监听socket会一直就绪导致空转。
+// 先释放预留的fd，接受一个连接并拒绝，再重新预留
+bool WebServer::RejectWithReserveFd(){
+    if(reserve_fd_ < 0)
+        return false;
+
+    close(reserve_fd_);
+    int fd = accept4(listen_fd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if(fd >= 0){
+        SendError(fd, SERVER_BUSY);
+        Metrics::Add(MC_REJECT);
+    }
+    reserve_fd_ = open("/dev/null", O_RDONLY | O_CLOEXEC);
+    LOG_WARN("Fd exhausted, reject client!");
+    return fd >= 0;
+}
+
 void WebServer::CloseConn(HttpConn* client){
     assert(client);
     LOG_INFO("Client[%d] quit", client->GetFd());
@@ -199,125 +328,792 @@ void WebServer::CloseConn(HttpConn* client){
 void WebServer::AddClient(int fd, sockaddr_in addr){
     assert(fd > 0);
     users_[fd].Init(fd, addr);              
+    if(options_.tcp_nodelay){
+        int optval = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &optval, sizeof(optval));
+    }
+    if(options_.so_busy_poll_us > 0){
+        SetBusyPoll(fd);
+    }
     if(time_out_ms_ > 0){
-        timer_->Add(fd, time_out_ms_, std::bind(&WebServer::CloseConn, this, &users_[fd]));
+        ArmDeadline(&users_[fd]);
     }
 
-    epoller_->AddFd(fd, EPOLLIN | conn_event_);     // 加入到epoll中，注册事件为IN
-    SetFdNoBlock(fd);       // 设置socket为非阻塞
+    if(uring_){
+        uring_->Attach(fd);
+        SubmitRecv(&users_[fd]);
+    }else if(is_owned_){
+        epoller_->AddFd(fd, EPOLLIN | EPOLLOUT | conn_event_);     // 所有权模式只注册这一次，之后不再修改
+    }else{
+        epoller_->AddFd(fd, EPOLLIN | conn_event_);     // 加入到epoll中，注册事件为IN
+    }
     LOG_INFO("Client[%d] in!", users_[fd].GetFd());
 }
 
-// 处理监听socket
+// 处理监听socket，accept4直接得到非阻塞的socket
+template<bool LISTEN_ET>
 void WebServer::DealListen(){
+    ACCOUNT_PHASE(AP_ACCEPT);
     struct sockaddr_in addr;        // 声明一个addr
-    socklen_t len = sizeof(addr);
+    listen_pending_ = false;
 
-    do{
-        int fd = accept(listen_fd_, (struct sockaddr*)&addr, &len);     // 接受这个socket
-        if(fd <= 0) return;         
-        else if(HttpConn::GetUserCount() >= MAX_FD){
-            SendError(fd, "Server Busy");
-            LOG_WARN("Clients is Full!");
+    for(int count = 0; ; count++){
+        if(count >= options_.accept_budget){
+            // 这一轮接受得够多了，先处理已有连接的事件。LT模式下一轮还会通知，ET模式要记下来主动再接受
+            listen_pending_ = LISTEN_ET;
             return;
         }
+
+        int64_t accept_us = Trace::IsOpen() ? Trace::NowUs() : 0;
+        socklen_t len = sizeof(addr);
+        int fd = accept4(listen_fd_, (struct sockaddr*)&addr, &len, SOCK_NONBLOCK | SOCK_CLOEXEC);     // 接受这个socket
+        if(fd < 0){
+            if(errno == EAGAIN || errno == EWOULDBLOCK)
+                return;         // 队列已经空了
+            // 对端在握手后就断开了或者被信号打断，只影响这一个连接，队列里后面的还要接受
+            if(errno == ECONNABORTED || errno == EPROTO || errno == EINTR)
+                continue;
+            if((errno == EMFILE || errno == ENFILE) && RejectWithReserveFd())
+                continue;
+            LOG_ERROR("accept error: %s", strerror(errno));
+            return;
+        }
+
+        Metrics::Add(MC_ACCEPT);
+        if(HttpConn::GetUserCount() >= MAX_FD){
+            Metrics::Add(MC_REJECT);
+            SendError(fd, SERVER_BUSY);         // 继续接受并拒绝，不让连接堆在队列里
+            LOG_WARN("Clients is Full!");
+            continue;
+        }
         AddClient(fd, addr);        // 否则将这个socket放入监听队列中
-    }while(listen_event_ & EPOLLET);
+        if(accept_us > 0){
+            Trace::Record(users_[fd].GetTraceId(), TP_ACCEPT, accept_us, Trace::NowUs());
+        }
+    }
+}
+
+// 已有模块自己维护的状态，在抓取时读取
+void WebServer::InitMetrics(){
+    Metrics& metrics = Metrics::Instance();
+    metrics.AddGauge("tinyweb_connections_active", "Open client connections.",
+            []{ return (double)HttpConn::GetUserCount(); });
+    metrics.AddGauge("tinyweb_pool_queue_depth", "Tasks waiting in the worker thread pool.",
+            []{ return (double)ThreadPool::Instance().QueueSize(); });
+    metrics.AddGauge("tinyweb_sql_queue_depth", "Tasks waiting for a database thread.",
+            []{ return (double)SqlExecutor::Instance().PendingCount(); });
+    metrics.AddGauge("tinyweb_sql_conn_free", "Idle connections in the SQL pool.",
+            []{ return (double)SqlConnPool::Instance().GetFreeConnCount(); });
+    metrics.AddCounter("tinyweb_sql_coalesced_total", "User lookups that shared a concurrent SELECT for the same name.",
+            []{ return (double)HttpRequest::GetCoalescedCount(); });
+    metrics.AddCounter("tinyweb_io_yields_total", "Events that used up the I/O budget and yielded the worker.",
+            []{ return (double)HttpConn::GetYieldCount(); });
+    if(UserFilter::Instance().IsOpen()){
+        metrics.AddCounter("tinyweb_user_filter_skips_total", "User lookups answered absent by the Bloom filter without a query.",
+                []{ return (double)UserFilter::Instance().GetSkipCount(); });
+        metrics.AddCounter("tinyweb_user_filter_false_positives_total", "Filter hits for names the database did not have.",
+                []{ return (double)UserFilter::Instance().GetFalsePositiveCount(); });
+        metrics.AddGauge("tinyweb_user_filter_fpr", "Observed false positive rate of the user filter.",
+                []{ return UserFilter::Instance().GetFalsePositiveRate(); });
+        metrics.AddGauge("tinyweb_user_filter_estimated_fpr", "False positive rate estimated from the filter's fill.",
+                []{ return UserFilter::Instance().GetEstimateFpr(); });
+    }
+    if(RegisterBuffer::Instance().IsOpen()){
+        metrics.AddCounter("tinyweb_register_flushes_total", "Batched register INSERTs committed.",
+                []{ return (double)RegisterBuffer::Instance().GetFlushCount(); });
+        metrics.AddCounter("tinyweb_register_flush_rows_total", "Registrations written by batched INSERTs.",
+                []{ return (double)RegisterBuffer::Instance().GetFlushRows(); });
+        metrics.AddCounter("tinyweb_register_flush_seconds_total", "Time spent in batched register INSERTs.",
+                []{ return RegisterBuffer::Instance().GetFlushUs() / 1e6; });
+        metrics.AddGauge("tinyweb_register_flush_max_batch", "Largest register batch written so far.",
+                []{ return (double)RegisterBuffer::Instance().GetMaxBatch(); });
+        metrics.AddCounter("tinyweb_register_lost_total", "Acknowledged registrations ignored by the INSERT as duplicates.",
+                []{ return (double)RegisterBuffer::Instance().GetLostCount(); });
+    }
+    if(FileCache::Instance().IsOpen()){
+        metrics.AddCounter("tinyweb_file_cache_hits_total", "Static file cache hits.",
+                []{ return (double)FileCache::Instance().GetHitCount(); });
+        metrics.AddCounter("tinyweb_file_cache_misses_total", "Static file cache misses.",
+                []{ return (double)FileCache::Instance().GetMissCount(); });
+        metrics.AddGauge("tinyweb_file_cache_bytes", "Bytes held by the static file cache.",
+                []{ return (double)FileCache::Instance().GetBytes(); });
+    }
+    LOG_INFO("Metrics served at %s", METRICS_PATH);
+}
+
+// 收到SIGINT/SIGTERM后退出事件循环，正常析构
+static volatile sig_atomic_t stop_signal = 0;
+
+static void HandleStopSignal(int){
+    stop_signal = 1;
+}
+
+// 收到SIGUSR1后导出请求追踪
+static volatile sig_atomic_t trace_signal = 0;
+
+static void HandleTraceSignal(int){
+    trace_signal = 1;
+}
+
+// 在线程池中写文件，不阻塞事件循环
+void WebServer::DumpTrace(){
+    std::string file = "./trace_" + std::to_string(getpid()) + "_" + std::to_string(time(nullptr)) + ".json";
+    ThreadPool::Instance().commit([file]{
+        if(Trace::Instance().DumpFile(file)){
+            LOG_INFO("Trace dumped to %s", file.c_str());
+        }else{
+            LOG_WARN("Trace dump to %s error", file.c_str());
+        }
+    });
+}
+
+// 忙轮询：先用0超时反复等待一段时间，有事件就立即返回，省去线程睡眠和唤醒的延迟；自旋期间没有事件再阻塞等待
+int WebServer::BusyWait(int time_out_ms){
+    auto start = std::chrono::steady_clock::now();
+    auto spin_end = start + std::chrono::microseconds(options_.busy_poll_us);
+    if(time_out_ms >= 0 && start + std::chrono::milliseconds(time_out_ms) < spin_end){
+        spin_end = start + std::chrono::milliseconds(time_out_ms);      // 定时器先到期就不用自旋那么久
+    }
+
+    auto now = start;
+    do{
+        int n = epoller_->Wait(0);
+        now = std::chrono::steady_clock::now();
+        if(n != 0){
+            spin_ns_ += std::chrono::duration_cast<std::chrono::nanoseconds>(now - start).count();
+            spin_hit_++;
+            return n;
+        }
+    }while(now < spin_end && !stop_signal);
+
+    spin_ns_ += std::chrono::duration_cast<std::chrono::nanoseconds>(now - start).count();
+    spin_miss_++;
+
+    int remain_ms = -1;
+    if(time_out_ms >= 0){
+        remain_ms = time_out_ms - (int)std::chrono::duration_cast<std::chrono::milliseconds>(now - start).count();
+        remain_ms = std::max(remain_ms, 0);
+    }
+    return epoller_->Wait(remain_ms);
+}
+
+// 绑定事件循环和工作线程的CPU，并打印拓扑。
+// 连接的缓冲区在事件循环线程第一次写入时分配，文件缓存由工作线程读入，按first-touch策略都落在线程所在的NUMA节点上，
+// 所以工作线程默认和事件循环放在同一个节点。新线程会继承创建者的绑定，要在其他线程都创建好以后再绑定事件循环
+void WebServer::InitAffinity(){
+    LOG_INFO("CPU topology: %s", Topology::Report().c_str());
+    ThreadPool::Instance();         // 线程池是第一次使用时创建的，先创建好，避免工作线程继承事件循环的绑定
+
+    if(options_.loop_cpu >= 0){
+        if(Topology::PinThread(pthread_self(), options_.loop_cpu)){
+            LOG_INFO("Event loop pinned to cpu %d (node %d)", options_.loop_cpu, Topology::NodeOfCpu(options_.loop_cpu));
+        }else{
+            LOG_WARN("Pin event loop to cpu %d error", options_.loop_cpu);
+        }
+    }
+
+    if(!options_.worker_cpus || !options_.worker_cpus[0])
+        return;
+
+    std::vector<int> cpus;
+    if(strcmp(options_.worker_cpus, "node") == 0){
+        int node = Topology::NodeOfCpu(options_.loop_cpu >= 0 ? options_.loop_cpu : sched_getcpu());
+        for(int cpu : Topology::NodeCpus(node)){
+            if(cpu != options_.loop_cpu)            // 节点只有一个CPU时只能和事件循环共用
+                cpus.push_back(cpu);
+        }
+        if(cpus.empty())
+            cpus = Topology::NodeCpus(node);
+    }else{
+        cpus = Topology::ParseCpuList(options_.worker_cpus);
+    }
+    if(cpus.empty()){
+        LOG_WARN("Worker cpus \"%s\" has no online cpu", options_.worker_cpus);
+        return;
+    }
+
+    std::string assigned;
+    for(int cpu : ThreadPool::Instance().SetAffinity(cpus)){
+        if(!assigned.empty())
+            assigned += ",";
+        assigned += std::to_string(cpu);
+    }
+    LOG_INFO("Worker threads pinned to cpus: %s", assigned.c_str());
+}
+
+// 事件循环
+template<bool LISTEN_ET, bool CONN_ET>
+void WebServer::Loop(){
+    int time_ms = -1;
+    while(!is_close_ && !stop_signal){
+        time_ms = NextTick();       // 获取下一个超时等待时间
+        if(listen_pending_){
+            time_ms = 0;            // 队列里还有连接，不等待
+        }
+
+        int eventCnt;
+        if(options_.busy_poll_us > 0){
+            if(loop_start_.time_since_epoch().count() != 0){          // 上一轮处理事件和定时器用的时间
+                work_ns_ += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - loop_start_).count();
+            }
+            eventCnt = BusyWait(time_ms);
+        }else{
+            eventCnt = epoller_->Wait(time_ms);     // 超时事件设置为下一个超时事件的时间
+        }
+        loop_start_ = std::chrono::steady_clock::now();
+        if(trace_signal){
+            trace_signal = 0;
+            DumpTrace();
+        }
+        if(listen_pending_){
+            DealListen<LISTEN_ET>();
+        }
+        for(int i = 0 ; i < eventCnt; i++){
+            int fd = epoller_->GetEventFd(i);       // 获取事件中文件描述符
+            uint32_t events = epoller_->GetEvents(i);       // 获取事件的事件类型
+            
+            if(fd == listen_fd_){       // 如果是我们的监听socket
+                DealListen<LISTEN_ET>();
+            }else if(CONN_ET && is_owned_){        // 所有权模式，所有事件都交给持有连接的线程
+                assert(users_.count(fd) > 0);
+                DealOwned(&users_[fd], events);
+            }else if(events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR)){      // 如果是关闭或者错误
+                assert(users_.count(fd) > 0);
+                CloseConn(&users_[fd]);     // 关闭socket
+            }else if(events & EPOLLIN){
+                assert(users_.count(fd) > 0);
+                DealRead<CONN_ET>(&users_[fd]);      // 处理读事件
+            }else if(events & EPOLLOUT){
+                assert(users_.count(fd) > 0);
+                DealWrite<CONN_ET>(&users_[fd]);
+            }else {
+                LOG_ERROR("Unexpected Event");
+            }
+        }
+    }
 }
 
 void WebServer::Start(){
-    int time_ms = -1;       
     if(!is_close_){
+        struct sigaction sa;
+        memset(&sa, 0, sizeof(sa));
+        sa.sa_handler = HandleStopSignal;           // 不设置SA_RESTART，让阻塞的等待被信号打断
+        sigaction(SIGINT, &sa, nullptr);
+        sigaction(SIGTERM, &sa, nullptr);
+        signal(SIGPIPE, SIG_IGN);                   // 对端关闭后再写不能让进程退出
+        if(options_.trace){
+            sa.sa_handler = HandleTraceSignal;
+            sigaction(SIGUSR1, &sa, nullptr);
+        }
+
         LOG_INFO("==============Server Start================");
-        while(!is_close_){
-            if(time_out_ms_ > 0){
-                time_ms = timer_->GetNextTick();        // 获取下一个超时等待时间
-            }
+        // 触发模式在启动时确定，每种组合是一份单独实例化的事件循环，读写和accept的循环里不再判断触发模式
+        bool listen_et = listen_event_ & EPOLLET;
+        bool conn_et = conn_event_ & EPOLLET;
+        if(uring_){
+            LoopUring();
+        }else if(listen_et && conn_et){
+            Loop<true, true>();
+        }else if(listen_et){
+            Loop<true, false>();
+        }else if(conn_et){
+            Loop<false, true>();
+        }else{
+            Loop<false, false>();
+        }
+        LOG_INFO("==============Server Stop=================");
+        LOG_INFO("IO Backend: %s, syscalls: %llu", epoller_->Name(), (unsigned long long)epoller_->GetSyscallCount());
+        if(is_owned_){
+            LOG_INFO("Conn ownership saved epoll_ctl: %llu", (unsigned long long)saved_ctl_.load());
+        }
+        if(options_.busy_poll_us > 0){
+            LOG_INFO("Busy poll spin: %llu ms (hit %llu, then blocked %llu), work: %llu ms",
+                    (unsigned long long)(spin_ns_ / 1000000), (unsigned long long)spin_hit_, (unsigned long long)spin_miss_,
+                    (unsigned long long)(work_ns_ / 1000000));
+        }
+        if(options_.io_budget_bytes > 0){
+            LOG_INFO("I/O budget yields: %llu", (unsigned long long)HttpConn::GetYieldCount());
+        }
+        if(options_.inline_static){
+            LOG_INFO("Inline requests: %llu, offloaded: %llu", (unsigned long long)Metrics::Instance().Get(MC_INLINE), (unsigned long long)Metrics::Instance().Get(MC_OFFLOAD));
+        }
+#ifdef TINYWEB_ACCOUNTING
+        std::string report = Accounting::Report();
+        fprintf(stderr, "Syscall accounting, %s", report.c_str());
+        LOG_INFO("Syscall accounting, %s", report.c_str());
+#endif
+        if(FileCache::Instance().IsOpen()){
+            LOG_INFO("FileCache hit: %llu, miss: %llu, bytes: %d", (unsigned long long)FileCache::Instance().GetHitCount(),
+                    (unsigned long long)FileCache::Instance().GetMissCount(), (int)FileCache::Instance().GetBytes());
+        }
+    }
+}
 
-            int eventCnt = epoller_->Wait(time_ms);     // 超时事件设置为下一个超时事件的时间
-            for(int i = 0 ; i < eventCnt; i++){
-                int fd = epoller_->GetEventFd(i);       // 获取事件中文件描述符
-                uint32_t events = epoller_->GetEvents(i);       // 获取事件的事件类型
-                
-                if(fd == listen_fd_){       // 如果是我们的监听socket
-                    DealListen();
-                }else if(events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR)){      // 如果是关闭或者错误
-                    assert(users_.count(fd) > 0);
-                    CloseConn(&users_[fd]);     // 关闭socket
-                }else if(events & EPOLLIN){
-                    assert(users_.count(fd) > 0);
-                    DealRead(&users_[fd]);      // 处理读事件
-                }else if(events & EPOLLOUT){
-                    assert(users_.count(fd) > 0);
-                    DealWrite(&users_[fd]);
-                }else {
-                    LOG_ERROR("Unexpected Event");
-                }
-            }
+// 定时清理过期会话，清理完再把自己加回定时器
+void WebServer::SweepSession(){
+    int count = SessionStore::Instance().Expire();
+    if(count > 0){
+        LOG_INFO("Session expired: %d, remain: %d", count, (int)SessionStore::Instance().Size());
+    }
+    timer_->Add(SESSION_TIMER_ID, options_.session_sweep_ms, std::bind(&WebServer::SweepSession, this));
+}
+
+// socket接收数据时在驱动队列上忙轮询，需要网卡支持NAPI，超过net.core.busy_read的值需要CAP_NET_ADMIN
+void WebServer::SetBusyPoll(int fd){
+    int optval = options_.so_busy_poll_us;
+    if(setsockopt(fd, SOL_SOCKET, SO_BUSY_POLL, &optval, sizeof(optval)) < 0){
+        LOG_WARN("set SO_BUSY_POLL on [%d] error: %s", fd, strerror(errno));
+        return;
+    }
+    optval = 1;
+    if(setsockopt(fd, SOL_SOCKET, SO_PREFER_BUSY_POLL, &optval, sizeof(optval)) < 0){
+        LOG_WARN("set SO_PREFER_BUSY_POLL on [%d] error: %s", fd, strerror(errno));
+    }
+}
+
+// 定时器到期时检查连接当前阶段的期限，期限被推后了就按新的期限重新加入定时器，否则关闭连接。
+// 期限由处理连接的线程在阶段变化时更新，事件循环不用在每个事件上调整定时器
+void WebServer::OnDeadline(HttpConn* client){
+    assert(client);
+    if(client->IsClose())
+        return;
+
+    int64_t left = client->GetDeadline() - HttpConn::NowMs();
+    if(left > 0){
+        ArmDeadline(client);
+        return;
+    }
+
+    LOG_INFO("Client[%d] %s timeout", client->GetFd(), HttpConn::PhaseName(client->GetPhase()));
+    Metrics::Add(MC_TIMEOUT);
+    CloseTimeout(client);
+}
+
+// 按连接当前的期限设置定时器。设置期间其他线程可能又提前了期限，这时按新的期限重新设置；
+// 之后再提前的都会被SetDeadline看到并记下来
+void WebServer::ArmDeadline(HttpConn* client){
+    int64_t deadline;
+    do{
+        deadline = client->GetDeadline();
+        client->SetArmed(deadline);
+    }while(client->GetDeadline() < deadline);
+
+    int64_t left = std::max<int64_t>(deadline - HttpConn::NowMs(), 0);
+    timer_->Add(client->GetFd(), (int)std::min<int64_t>(left, INT32_MAX), std::bind(&WebServer::OnDeadline, this, client));
+}
+
+// 把期限被提前的连接的定时器提前
+void WebServer::ArmShortened(){
+    HttpConn::TakeShortened(&shortened_);
+    for(int fd : shortened_){
+        auto it = users_.find(fd);
+        if(it != users_.end() && !it->second.IsClose()){
+            ArmDeadline(&it->second);
         }
     }
 }
 
-void WebServer::ExtendTime(HttpConn* client){
+// 事件循环这一轮最多等待多久。其他线程提前的期限不会唤醒事件循环，所以最多等待最短的阶段超时，
+// 醒来后调整定时器，期限不会晚于这时才被发现
+int WebServer::NextTick(){
+    if(time_out_ms_ <= 0 && !options_.session)
+        return -1;
+    ArmShortened();
+    int time_ms = timer_->GetNextTick();
+    if(tick_ms_ > 0 && (time_ms < 0 || time_ms > tick_ms_))
+        time_ms = tick_ms_;
+    return time_ms;
+}
+
+// 定时器超时关闭连接。连接可能正被其他线程持有(所有权模式，或者正在等待数据库)，这时只留下关闭标志，由持有者关闭
+void WebServer::CloseTimeout(HttpConn* client){
     assert(client);
-    if(time_out_ms_ > 0) {timer_->Adjust(client->GetFd(), time_out_ms_);}
+    if(client->Acquire(CONN_CLOSE)){
+        CloseConn(client);
+    }
 }
 
 // 处理报文
+template<bool CONN_ET>
 void WebServer::OnProcess(HttpConn* client){
-    if(client->process()){      // 解析请求报文，并且生成响应报文
-        epoller_->ModFd(client->GetFd(), conn_event_ | EPOLLOUT);       // 设置事件为OUT
+    client->TraceDequeued();
+    // 解析请求报文并生成响应，直接尝试写回，写不完才注册OUT事件，小响应不用再等一轮epoll。
+    // 写完后缓冲区里可能还有流水线请求，它们不会再触发IN事件，接着处理
+    while(client->process()){
+        if(!WriteBack<CONN_ET>(client))
+            return;
+    }
+    if(client->IsPendingSql()){       // 登录注册要查询数据库，交给数据库线程，工作线程直接返回
+        client->Acquire(0);         // 等待期间持有连接，定时器不能直接关闭，否则fd可能被新连接复用
+        client->TraceQueued(TP_SQL_QUEUE);
+        SqlExecutor::Instance().Commit(std::bind(&WebServer::OnSql<CONN_ET>, this, client));
     }else{
         epoller_->ModFd(client->GetFd(), conn_event_ | EPOLLIN);        // 如果没有要处理的报文，就为IN
     }
 }
 
+// 在数据库线程中执行，查询完成后生成响应报文并直接写回。挂起期间因为EPOLLONESHOT或者连接被持有，这个socket不会被其他线程处理
+template<bool CONN_ET>
+void WebServer::OnSql(HttpConn* client){
+    assert(client);
+    if(client->IsClose())           // 服务器关闭等情况下连接已经被关闭
+        return;
+
+    client->TraceDequeued();
+    if(CONN_ET && is_owned_){
+        client->ProcessSql();
+        OnOwned(client);            // 数据库线程仍然持有连接，直接写回并处理挂起期间到达的事件
+        return;
+    }
+
+    // 非所有权模式只在等待数据库期间持有连接，等待时超时的连接由这里关闭
+    if(client->TakeEvents() & CONN_CLOSE){
+        CloseConn(client);
+        return;
+    }
+    client->ProcessSql();
+    if(!client->Release()){
+        CloseConn(client);
+        return;
+    }
+    if(uring_){
+        SubmitWrite(client);
+        return;
+    }
+    OnWrite<CONN_ET>(client);
+}
+
 // 处理读取
+template<bool CONN_ET>
 void WebServer::OnRead(HttpConn* client){
     assert(client);
+    client->TraceDequeued();
     int ret = -1;
     int read_errno = 0;
-    ret = client->read(&read_errno);        // 读取请求报文
+    ret = client->read<CONN_ET>(&read_errno);        // 读取请求报文
     if(ret <= 0 && read_errno != EAGAIN){       
         CloseConn(client);
         return;
     }
 
-    OnProcess(client);
+    OnProcess<CONN_ET>(client);
 }
 
 // 处理写事件
+template<bool CONN_ET>
 void WebServer::OnWrite(HttpConn* client){
     assert(client);
+    client->TraceDequeued();
+    if(WriteBack<CONN_ET>(client)){
+        OnProcess<CONN_ET>(client);         // 处理写完前已经收到的流水线请求，没有就重新注册IN
+    }
+}
+
+// 写回响应报文。写完并且保持连接时返回true，由调用者处理下一个请求；否则已经注册OUT或者关闭了连接
+template<bool CONN_ET>
+bool WebServer::WriteBack(HttpConn* client){
     int ret = -1;
     int write_errno = 0;
 
-    ret = client->write(&write_errno);  // 将响应报文写入
+    ret = client->write<CONN_ET>(&write_errno);  // 将响应报文写入
     if(client->ToWriteBytes() == 0){        // 如果写完了
-        if(client->IsKeepAlive()){      // 并且socket设置的是keepalive
-            epoller_->ModFd(client->GetFd(), conn_event_ | EPOLLIN);    // 再设置为IN
-            return;
-        }
-    }else if(ret < 0){      // 如果响应报文没写完
-        if(write_errno == EAGAIN){      // 并且异常为EAGAIN
-            epoller_->ModFd(client->GetFd(), conn_event_ | EPOLLOUT);       // 再次设置为OUT，等待下次写入
-            return;
-        }
+        if(client->IsKeepAlive())       // 并且socket设置的是keepalive
+            return true;
+    }else if(ret > 0 || write_errno == EAGAIN){      // 响应报文没写完，LT模式写一部分就返回，或者缓冲区已满
+        epoller_->ModFd(client->GetFd(), conn_event_ | EPOLLOUT);       // 再次设置为OUT，等待下次写入
+        return false;
     }
 
     CloseConn(client);
+    return false;
 }
 
 // 处理socket的读事件
+template<bool CONN_ET>
 void WebServer::DealRead(HttpConn* client){
     assert(client);
-    ExtendTime(client);         // 延长socket的超时时间    
-    ThreadPool::Instance().commit(std::bind(&WebServer::OnRead, this, client));     // 在线程池中处理读取
+    if(InInlineBudget()){
+        DealReadInline<CONN_ET>(client);
+        return;
+    }
+    Metrics::Add(MC_OFFLOAD);
+    client->TraceQueued(TP_QUEUE);
+    ThreadPool::Instance().commit(std::bind(&WebServer::OnRead<CONN_ET>, this, client));     // 在线程池中处理读取
+}
+
+// 事件循环线程直接读取，命中缓存的静态请求就地生成响应并写回，其他请求再交给线程池处理
+template<bool CONN_ET>
+void WebServer::DealReadInline(HttpConn* client){
+    int read_errno = 0;
+    ssize_t ret = client->read<CONN_ET>(&read_errno);
+    if(ret <= 0 && read_errno != EAGAIN){
+        CloseConn(client);
+        return;
+    }
+
+    if(!client->HasRequest() || client->CanInline()){
+        if(client->HasRequest())
+            Metrics::Add(MC_INLINE);
+        OnProcess<CONN_ET>(client);
+        return;
+    }
+    Metrics::Add(MC_OFFLOAD);
+    client->TraceQueued(TP_QUEUE);
+    ThreadPool::Instance().commit(std::bind(&WebServer::OnProcess<CONN_ET>, this, client));
 }
 
 // 处理socket的写事件
+template<bool CONN_ET>
 void WebServer::DealWrite(HttpConn* client){
     assert(client);
-    ExtendTime(client);
-    ThreadPool::Instance().commit(std::bind(&WebServer::OnWrite,this,client));
-}
\ No newline at end of file
+    client->TraceQueued(TP_QUEUE);
+    ThreadPool::Instance().commit(std::bind(&WebServer::OnWrite<CONN_ET>,this,client));
+}
+
+// 本轮事件循环还有没有时间直接处理请求
+bool WebServer::InInlineBudget() const{
+    return options_.inline_static &&
+        std::chrono::steady_clock::now() - loop_start_ < std::chrono::microseconds(options_.inline_budget_us);
+}
+
+// 所有权模式的事件分发：连接空闲就持有它并交给线程池，否则事件记在连接上由当前持有者处理
+void WebServer::DealOwned(HttpConn* client, uint32_t events){
+    assert(client);
+    if(!client->Acquire(events))
+        return;
+
+    if(InInlineBudget()){
+        DealOwnedInline(client);
+        return;
+    }
+    Metrics::Add(MC_OFFLOAD);
+    client->TraceQueued(TP_QUEUE);
+    ThreadPool::Instance().commit(std::bind(&WebServer::OnOwned, this, client));
+}
+
+// 所有权模式下的直接处理，事件循环线程已经持有连接
+void WebServer::DealOwnedInline(HttpConn* client){
+    if(!ReadOwned(client, client->TakeEvents()))
+        return;
+
+    if(client->ToWriteBytes() == 0 && (!client->HasRequest() || client->CanInline())){
+        if(client->HasRequest())
+            Metrics::Add(MC_INLINE);
+        if(!ProcessOwned(client) || YieldOwned(client))
+            return;
+        if(!client->Release()){         // 处理期间又有事件到达
+            client->TraceQueued(TP_QUEUE);
+            ThreadPool::Instance().commit(std::bind(&WebServer::OnOwned, this, client));
+        }
+        return;
+    }
+    Metrics::Add(MC_OFFLOAD);
+    client->TraceQueued(TP_QUEUE);
+    ThreadPool::Instance().commit(std::bind(&WebServer::OnOwned, this, client));
+}
+
+// 持有连接的线程处理所有到达的事件，释放前没有新事件才算处理完。
+// 读写兴趣记在用户态：有没写完的响应就等OUT，否则等IN，socket的注册不需要修改
+void WebServer::OnOwned(HttpConn* client){
+    assert(client);
+    client->TraceDequeued();
+    do{
+        if(!ReadOwned(client, client->TakeEvents()) || !ProcessOwned(client) || YieldOwned(client))
+            return;
+    }while(!client->Release());
+}
+
+// 读写用完了这次事件的预算：把没处理完的方向放回连接，继续持有并重新排到线程池队尾，先让其他连接处理
+bool WebServer::YieldOwned(HttpConn* client){
+    uint32_t events = client->TakeYield();
+    if(!events)
+        return false;
+
+    client->Requeue(events);
+    client->TraceQueued(TP_QUEUE);
+    ThreadPool::Instance().commit(std::bind(&WebServer::OnOwned, this, client));
+    return true;
+}
+
+// 处理关闭和读事件，连接被关闭返回false
+bool WebServer::ReadOwned(HttpConn* client, uint32_t events){
+    if(events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR | CONN_CLOSE)){
+        CloseConn(client);          // 关闭后不再释放，fd复用时Init会重置状态
+        return false;
+    }
+
+    if(events & EPOLLIN){
+        int read_errno = 0;
+        ssize_t ret = client->read<true>(&read_errno);
+        if(ret <= 0 && read_errno != EAGAIN){
+            CloseConn(client);
+            return false;
+        }
+        saved_ctl_++;           // EPOLLONESHOT模式处理完读要重新注册一次
+    }
+    return true;
+}
+
+// 写回响应并解析缓冲区中的请求。连接被关闭或者交给了数据库线程返回false，这时调用者不能再释放连接
+bool WebServer::ProcessOwned(HttpConn* client){
+    // 先写还没写完的响应，比如上次写到EAGAIN，或者数据库线程刚生成的响应
+    if(client->ToWriteBytes() > 0 && !WriteOwned(client))
+        return false;
+
+    // 响应写完才解析下一个请求，写完后缓冲区里还有流水线请求就接着处理
+    while(client->ToWriteBytes() == 0){
+        if(!client->process()){
+            if(client->IsPendingSql()){         // 交给数据库线程，连接继续被持有，查询完成后由OnSql接着处理
+                client->TraceQueued(TP_SQL_QUEUE);
+                SqlExecutor::Instance().Commit(std::bind(&WebServer::OnSql<true>, this, client));
+                return false;
+            }
+            break;
+        }
+        if(!WriteOwned(client))
+            return false;
+    }
+    return true;
+}
+
+// 直接写回响应，写不完就等下一次OUT边沿或者让出后重新排队。连接被关闭返回false
+bool WebServer::WriteOwned(HttpConn* client){
+    int write_errno = 0;
+    ssize_t ret = client->write<true>(&write_errno);
+    saved_ctl_++;           // EPOLLONESHOT模式每次写完都要重新注册一次
+    if(client->ToWriteBytes() == 0){
+        if(client->IsKeepAlive())
+            return true;
+    }else if(ret > 0 || write_errno == EAGAIN){         // 用完预算让出，或者缓冲区已满
+        return true;
+    }
+
+    CloseConn(client);
+    return false;
+}
+
+// io_uring完成模式的事件循环。accept、recv、writev都提交到环里，和等待合并成一次io_uring_enter，
+// 完成后在事件循环线程解析请求并生成响应(静态文件来自文件缓存)，只有数据库校验交给数据库线程
+void WebServer::LoopUring(){
+    while(!is_close_ && !stop_signal){
+        int time_ms = NextTick();
+
+        int cnt = uring_->Wait(time_ms);
+        loop_start_ = std::chrono::steady_clock::now();
+        if(trace_signal){
+            trace_signal = 0;
+            DumpTrace();
+        }
+        for(int i = 0; i < cnt; i++){
+            int fd = uring_->GetEventFd(i);
+            int res = uring_->GetResult(i);
+            switch (uring_->GetOp(i)) {
+                case URING_ACCEPT:
+                    OnAccepted(res);
+                    break;
+                case URING_RECV:
+                    assert(users_.count(fd) > 0);
+                    OnRecv(&users_[fd], res);
+                    break;
+                case URING_WRITEV:
+                    assert(users_.count(fd) > 0);
+                    OnWritev(&users_[fd], res);
+                    break;
+                default:
+                    LOG_ERROR("Unexpected Event");
+                    break;
+            }
+        }
+    }
+}
+
+// accept的完成结果，fd为负数时是-errno。multishot accept不返回地址，另外取一次
+void WebServer::OnAccepted(int fd){
+    ACCOUNT_PHASE(AP_ACCEPT);
+    if(fd < 0){
+        if(fd == -EMFILE || fd == -ENFILE){
+            RejectWithReserveFd();
+        }else{
+            LOG_WARN("accept error: %s", strerror(-fd));
+        }
+        return;
+    }
+
+    Metrics::Add(MC_ACCEPT);
+    if(HttpConn::GetUserCount() >= MAX_FD){
+        Metrics::Add(MC_REJECT);
+        SendError(fd, SERVER_BUSY);
+        LOG_WARN("Clients is Full!");
+        return;
+    }
+    struct sockaddr_in addr;
+    socklen_t len = sizeof(addr);
+    if(getpeername(fd, (struct sockaddr*)&addr, &len) < 0){
+        memset(&addr, 0, sizeof(addr));
+    }
+    AddClient(fd, addr);
+}
+
+void WebServer::OnRecv(HttpConn* client, int res){
+    if(res == -EINTR || res == -EAGAIN){
+        SubmitRecv(client);
+        return;
+    }
+    if(res <= 0){           // 对端关闭或者出错
+        CloseConn(client);
+        return;
+    }
+
+    client->Received(res);
+    ProcessUring(client);
+}
+
+void WebServer::OnWritev(HttpConn* client, int res){
+    if(res == -EINTR || res == -EAGAIN){
+        SubmitWrite(client);
+        return;
+    }
+    if(res < 0){
+        CloseConn(client);
+        return;
+    }
+
+    client->Sent(res);
+    if(client->ToWriteBytes() > 0){         // 只写出了一部分
+        SubmitWrite(client);
+    }else if(client->IsKeepAlive()){
+        ProcessUring(client);           // 缓冲区里可能还有流水线请求
+    }else{
+        CloseConn(client);
+    }
+}
+
+// 解析缓冲区中的请求，有完整请求就提交响应，要查数据库就交给数据库线程，否则继续接收
+void WebServer::ProcessUring(HttpConn* client){
+    if(client->process()){
+        Metrics::Add(MC_INLINE);
+        SubmitWrite(client);
+    }else if(client->IsPendingSql()){
+        client->Acquire(0);         // 等待期间持有连接，定时器不能直接关闭
+        client->TraceQueued(TP_SQL_QUEUE);
+        SqlExecutor::Instance().Commit(std::bind(&WebServer::OnSql<false>, this, client));
+    }else{
+        SubmitRecv(client);
+    }
+}
+
+void WebServer::SubmitRecv(HttpConn* client){
+    std::size_t len = 0;
+    char* buf = client->RecvBuffer(&len);
+    if(!uring_->Recv(client->GetFd(), buf, len)){
+        CloseConn(client);
+    }
+}
+
+void WebServer::SubmitWrite(HttpConn* client){
+    int cnt = 0;
+    const struct iovec* iov = client->WriteIov(&cnt);
+    if(!uring_->Writev(client->GetFd(), iov, cnt)){
+        CloseConn(client);
+    }
+}
@@ -2,24 +2,89 @@
 #define WEBSERVER_H
 
 #include "../Timer/heaptimer.h"
-#include "../Epoller/epoller.h"
+#include "../Epoller/poller.h"
 #include "../Http/httpconn.h"
 
+class UringPoller;
 
+
+#include <atomic>
+#include <chrono>
 #include <cstdint>
 #include <memory>
 #include <netinet/in.h>
 #include <unordered_map>
+#include <vector>
 #include <unistd.h>
 #include <fcntl.h>
 
 constexpr int MAX_FD = 65535;
+constexpr const char* SERVER_BUSY = "HTTP/1.1 503 Service Unavailable\r\nContent-length: 0\r\nConnection: close\r\n\r\n";       // 过载时直接拒绝的响应
+constexpr int SESSION_TIMER_ID = -1;        // 定时器中清理会话任务的id
+
+// 可选功能的配置，默认值保持原来的行为
+struct ServerOptions{
+    bool register_write_behind = false;     // 注册写回缓冲，批量落库
+    int register_batch_size = 64;           // 攒够多少条注册就落库
+    int register_flush_ms = 200;            // 最长多久落库一次
+
+    bool user_filter = false;               // 用户名布隆过滤器，不存在的用户名不查数据库
+    int user_filter_capacity = 100000;      // 预期用户数量
+    int user_filter_rebuild_ms = 600000;    // 后台重建间隔，0为不重建
+
+    bool session = false;                   // 登录会话，登录后凭cookie访问受保护页面
+    int session_ttl_ms = 1800000;           // 会话有效期，访问时顺延
+    int session_sweep_ms = 60000;           // 定时清理过期会话的间隔
+
+    IO_BACKEND io_backend = BACKEND_EPOLL;  // I/O后端，内核不支持io_uring时退回epoll
+    bool uring_io = true;                   // io_uring后端直接提交accept/recv/writev，请求在事件循环线程处理，会同时开启文件缓存；false只用它做就绪通知
+
+    bool conn_ownership = true;             // 连接为ET时不使用EPOLLONESHOT，由持有连接的线程处理事件，省去重新注册
+
+    int header_timeout_ms = 0;              // 从连接建立或者收到请求第一个字节开始，多久内要收完请求头，0为使用time_out_ms
+    int body_timeout_ms = 0;                // 收完请求头后多久内要收完请求体，0为使用time_out_ms
+    int idle_timeout_ms = 0;                // keep-alive连接空闲多久关闭，0为使用time_out_ms
+    int write_timeout_ms = 0;               // 处理请求以及响应两次写出数据之间的最长时间，0为使用time_out_ms
+    int max_keep_alive_requests = 0;        // 一条连接最多处理多少个请求，0为不限制
+    int max_header_bytes = 0;               // 请求头最大字节数，超过回应400并关闭连接，0为不限制
+    int max_body_bytes = 0;                 // Content-length上限，超过回应413并关闭连接，0为不限制
+
+    int io_budget_bytes = 0;                // 一次事件最多读写多少字节，用完就让出线程重新排队，0为不限制
+
+    int busy_poll_us = 0;                   // 事件循环阻塞前先忙轮询多久，用CPU换延迟，0为不开启
+    int so_busy_poll_us = 0;                // socket的SO_BUSY_POLL时间，同时开启SO_PREFER_BUSY_POLL，0为不设置
+    int loop_cpu = -1;                      // 事件循环线程(同时负责accept)绑定的CPU，-1为不绑定
+    const char* worker_cpus = nullptr;      // 线程池工作线程绑定的CPU列表，如"0-3,8"；"node"为事件循环所在NUMA节点的其他CPU；空为不绑定
+
+    int listen_backlog = 6;                 // listen的等待队列长度
+    int accept_budget = 64;                 // 每轮事件循环最多接受多少个连接，剩下的下一轮再接受
+
+    bool tcp_nodelay = false;               // 连接关闭Nagle算法，响应不用等上一段的ACK
+    bool tcp_cork = false;                  // 响应一次写不完时加TCP_CORK，剩下的按整段发出
+    int defer_accept_s = 0;                 // 监听socket的TCP_DEFER_ACCEPT，收到数据才唤醒accept，0为不开启
+    int fastopen_qlen = 0;                  // 监听socket的TCP_FASTOPEN队列长度，0为不开启
+
+    bool file_cache = false;                // 小静态文件缓存在内存中
+    int file_cache_max_file = 256 * 1024;   // 超过这个大小的文件不缓存
+    int file_cache_capacity = 64 * 1024 * 1024;     // 缓存的总字节数
+    bool inline_static = false;             // 事件循环线程直接处理命中缓存的静态请求，会同时开启文件缓存
+    int inline_budget_us = 200;             // 每轮事件循环最多花多少时间直接处理请求，超过的交给线程池
+
+    bool metrics = false;                   // 在/metrics返回Prometheus格式的指标
+
+    bool trace = false;                     // 记录请求各阶段的耗时，SIGUSR1写文件或者访问/debug/trace导出
+    int trace_sample_n = 0;                 // 每多少个请求采样一个导出，0为不采样
+    int trace_slow_ms = 0;                  // 超过这个时间的请求都导出，0为不按时间导出
+
+    const char* capture_file = nullptr;     // 把收到的原始请求字节抓到这个文件，用bin/replay回放，nullptr为不抓包
+};
 
 class WebServer{
 public:
     WebServer(int port, int trig_mode, int time_out_ms, bool opt_linger,
             int sql_port, const char* sql_user, const char* sql_pwd, const char* db_name, int conn_pool_num, 
-            bool open_log, int log_level, int log_que_size);
+            bool open_log, int log_level, int log_que_size,
+            const ServerOptions& options = ServerOptions());
 
     ~WebServer();
     void Start();
@@ -27,33 +92,88 @@ public:
 private:
     void InitEventMode(int trig_mode);
     bool InitSocket();
+    template<bool LISTEN_ET, bool CONN_ET>
+    void Loop();
+    template<bool LISTEN_ET>
     void DealListen();
     void SendError(int fd, const char* info);
+    bool RejectWithReserveFd();
     void CloseConn(HttpConn* client);
     void AddClient(int fd, sockaddr_in addr);
-    void ExtendTime(HttpConn* client);
     int SetFdNoBlock(int fd);
+    // 连接的读写按触发模式分别实例化
+    template<bool CONN_ET>
     void OnProcess(HttpConn* client);
+    template<bool CONN_ET>
+    void OnSql(HttpConn* client);
+    template<bool CONN_ET>
     void OnWrite(HttpConn* client);
+    template<bool CONN_ET>
+    bool WriteBack(HttpConn* client);
+    template<bool CONN_ET>
     void OnRead(HttpConn* client);
+    template<bool CONN_ET>
     void DealRead(HttpConn* client);
+    template<bool CONN_ET>
     void DealWrite(HttpConn* client);
+    template<bool CONN_ET>
+    void DealReadInline(HttpConn* client);
+    bool InInlineBudget() const;
+    void DealOwned(HttpConn* client, uint32_t events);
+    void DealOwnedInline(HttpConn* client);
+    void OnOwned(HttpConn* client);
+    bool ReadOwned(HttpConn* client, uint32_t events);
+    bool ProcessOwned(HttpConn* client);
+    bool WriteOwned(HttpConn* client);
+    bool YieldOwned(HttpConn* client);
+    int BusyWait(int time_out_ms);
+    void InitAffinity();
+    void InitMetrics();
+    void DumpTrace();
+    void SetBusyPoll(int fd);
+    void CloseTimeout(HttpConn* client);
+    void OnDeadline(HttpConn* client);
+    void ArmDeadline(HttpConn* client);
+    void ArmShortened();
+    int NextTick();
+    void SweepSession();
+    void LoopUring();
+    void OnAccepted(int fd);
+    void OnRecv(HttpConn* client, int res);
+    void OnWritev(HttpConn* client, int res);
+    void ProcessUring(HttpConn* client);
+    void SubmitRecv(HttpConn* client);
+    void SubmitWrite(HttpConn* client);
 
 
 private:
     int port_;
     bool opt_linger_;
     int time_out_ms_;
+    int header_timeout_ms_;     // 新连接的第一个期限
+    int tick_ms_;               // 各阶段超时中最短的，事件循环最多等待这么久，及时处理被提前的期限
     bool is_close_;
     int listen_fd_;
+    int reserve_fd_;            // 预留的fd，文件描述符用完时释放它来接受并拒绝连接
+    bool listen_pending_;       // ET模式下接受连接达到上限，队列里可能还有连接
     char* src_dir_;
+    ServerOptions options_;
 
     uint32_t listen_event_;     // 连接监听端口
     uint32_t conn_event_;
+    bool is_owned_;             // 连接所有权模式
+    std::atomic<uint64_t> saved_ctl_;       // 所有权模式下省去的epoll_ctl次数
+    std::chrono::steady_clock::time_point loop_start_;      // 本轮事件循环开始处理事件的时间
+    uint64_t spin_ns_;              // 忙轮询自旋的时间
+    uint64_t work_ns_;              // 处理事件的时间
+    uint64_t spin_hit_;             // 自旋期间等到事件的次数
+    uint64_t spin_miss_;            // 自旋结束还没有事件、转为阻塞等待的次数
 
     std::unique_ptr<HeapTimer> timer_;
-    std::unique_ptr<Epoller> epoller_;
+    std::unique_ptr<Poller> epoller_;
+    UringPoller* uring_;            // io_uring完成模式时指向epoller_，否则为空
     std::unordered_map<int, HttpConn> users_;
+    std::vector<int> shortened_;    // 期限被提前的连接，每轮循环从HttpConn取出
 };
 
 #endif
\ No newline at end of file
@@ -7,7 +7,8 @@
 
 Epoller::Epoller(int max_event) :
     epoll_fd_(epoll_create(512)),
-    events_(max_event)
+    events_(max_event),
+    syscall_count_(0)
 {
     assert(epoll_fd_ >= 0 && events_.size() > 0);
 }
@@ -22,6 +23,7 @@ bool Epoller::AddFd(int fd, uint32_t events){
     ev.data.fd = fd;
     ev.events = events;
     
+    syscall_count_++;
     if(epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &ev) == 0){
         return true;
     }else{
@@ -35,6 +37,7 @@ bool Epoller::ModFd(int fd, uint32_t events){
     ev.data.fd = fd;
     ev.events = events;
 
+    syscall_count_++;
     if(epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, fd, &ev) == 0){
         return true;
     }else{
@@ -46,10 +49,12 @@ bool Epoller::ModFd(int fd, uint32_t events){
 bool Epoller::DelFd(int fd){
     if(fd < 0) return false;
 
+    syscall_count_++;
     return 0 == epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, 0);
 }
 
 int Epoller::Wait(int time_out_ms){
+    syscall_count_++;
     return epoll_wait(epoll_fd_, &events_[0], (int)events_.size(), time_out_ms);
 }
 
@@ -61,4 +66,12 @@ int Epoller::GetEventFd(size_t i) const {
 uint32_t Epoller::GetEvents(size_t i) const {
     assert(i >= 0 && events_.size() > i);
     return events_[i].events;
+}
+
+const char* Epoller::Name() const {
+    return "epoll";
+}
+
+uint64_t Epoller::GetSyscallCount() const {
+    return syscall_count_.load();
 }
\ No newline at end of file
@@ -1,27 +1,32 @@
 #ifndef EPOLL_H
 #define EPOLL_H
 
+#include <atomic>
 #include <cstddef>
 #include <cstdint>
 #include <sys/epoll.h>
 #include <sys/types.h>
 #include <vector>
+#include "poller.h"
 
-class Epoller{
+class Epoller : public Poller{
 public:
     explicit Epoller(int max_event=1024);
     ~Epoller();
 
-    bool AddFd(int fd, uint32_t events);
-    bool ModFd(int fd, uint32_t events);
-    bool DelFd(int fd);
-    int Wait(int time_out_ms = -1);
-    int GetEventFd(size_t i) const;
-    uint32_t GetEvents(size_t i) const;
+    bool AddFd(int fd, uint32_t events) override;
+    bool ModFd(int fd, uint32_t events) override;
+    bool DelFd(int fd) override;
+    int Wait(int time_out_ms = -1) override;
+    int GetEventFd(size_t i) const override;
+    uint32_t GetEvents(size_t i) const override;
+    const char* Name() const override;
+    uint64_t GetSyscallCount() const override;
 
 private:
     int epoll_fd_;
     std::vector<struct epoll_event> events_;
+    std::atomic<uint64_t> syscall_count_;
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,17 @@
+#include "poller.h"
+#include "epoller.h"
+#include "uringpoller.h"
+#include "../Log/log.h"
+
+Poller* Poller::Create(IO_BACKEND backend, int max_event){
+    if(backend == BACKEND_URING){
+        UringPoller* poller = new UringPoller(max_event);
+        if(poller->IsValid())
+            return poller;
+
+        delete poller;
+        LOG_WARN("io_uring is not supported by this kernel, fall back to epoll");
+    }
+
+    return new Epoller(max_event);
+}
@@ -0,0 +1,32 @@
+#ifndef POLLER_H
+#define POLLER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <sys/epoll.h>
+
+// I/O多路复用后端
+enum IO_BACKEND{
+    BACKEND_EPOLL = 0,
+    BACKEND_URING = 1
+};
+
+// 事件循环使用的公共接口，事件类型统一使用epoll的EPOLLIN/EPOLLOUT/EPOLLET/EPOLLONESHOT等标志
+class Poller{
+public:
+    virtual ~Poller() = default;
+
+    virtual bool AddFd(int fd, uint32_t events) = 0;
+    virtual bool ModFd(int fd, uint32_t events) = 0;
+    virtual bool DelFd(int fd) = 0;
+    virtual int Wait(int time_out_ms = -1) = 0;
+    virtual int GetEventFd(size_t i) const = 0;
+    virtual uint32_t GetEvents(size_t i) const = 0;
+    virtual const char* Name() const = 0;
+    virtual uint64_t GetSyscallCount() const = 0;       // 后端自身发起的系统调用次数
+
+    // 创建指定的后端，内核不支持io_uring时退回epoll
+    static Poller* Create(IO_BACKEND backend, int max_event = 1024);
+};
+
+#endif
@@ -0,0 +1,470 @@
+#include "uringpoller.h"
+#include <cassert>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include "../Metrics/accounting.h"
+
+constexpr uint64_t REMOVE_USER_DATA = UINT64_MAX;       // POLL_REMOVE和ASYNC_CANCEL自身的完成事件，直接忽略
+constexpr unsigned URING_ENTRIES = 4096;
+
+// 构造函数所在的线程就是事件循环线程
+UringPoller::UringPoller(int max_event) :
+    ring_fd_(-1),
+    sq_head_(nullptr), sq_tail_(nullptr), sq_mask_(nullptr), sq_array_(nullptr),
+    sq_entries_(0),
+    sqes_((struct io_uring_sqe*)MAP_FAILED),
+    cq_head_(nullptr), cq_tail_(nullptr), cq_mask_(nullptr),
+    cqes_(nullptr),
+    sq_ptr_(MAP_FAILED), sq_size_(0),
+    cq_ptr_(MAP_FAILED), cq_size_(0),
+    sqes_size_(0),
+    to_submit_(0),
+    loop_tid_(std::this_thread::get_id()),
+    fds_(1024),
+    accept_multishot_(true),
+    events_(max_event),
+    event_cnt_(0),
+    syscall_count_(0)
+{
+    assert(events_.size() > 0);
+    if(!Setup(URING_ENTRIES) && ring_fd_ >= 0){
+        close(ring_fd_);
+        ring_fd_ = -1;
+    }
+}
+
+UringPoller::~UringPoller(){
+    if(sqes_ != MAP_FAILED)
+        munmap(sqes_, sqes_size_);
+    if(cq_ptr_ != MAP_FAILED && cq_ptr_ != sq_ptr_)
+        munmap(cq_ptr_, cq_size_);
+    if(sq_ptr_ != MAP_FAILED)
+        munmap(sq_ptr_, sq_size_);
+    if(ring_fd_ >= 0)
+        close(ring_fd_);
+}
+
+bool UringPoller::IsValid() const{
+    return ring_fd_ >= 0;
+}
+
+// 创建io_uring并映射提交队列、完成队列
+bool UringPoller::Setup(unsigned entries){
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    syscall_count_++;
+    ring_fd_ = syscall(__NR_io_uring_setup, entries, &params);
+    if(ring_fd_ < 0)
+        return false;
+
+    // EXT_ARG(5.11)用于带超时的等待，RSRC_TAGS(5.13)说明内核支持multishot poll，NODROP保证完成事件不丢
+    uint32_t need = IORING_FEAT_EXT_ARG | IORING_FEAT_RSRC_TAGS | IORING_FEAT_NODROP;
+    if((params.features & need) != need)
+        return false;
+
+    sq_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_size_ = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+    if(single_mmap){
+        sq_size_ = cq_size_ = (sq_size_ > cq_size_ ? sq_size_ : cq_size_);
+    }
+
+    sq_ptr_ = mmap(nullptr, sq_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQ_RING);
+    if(sq_ptr_ == MAP_FAILED)
+        return false;
+
+    if(single_mmap){
+        cq_ptr_ = sq_ptr_;
+    }else{
+        cq_ptr_ = mmap(nullptr, cq_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_CQ_RING);
+        if(cq_ptr_ == MAP_FAILED)
+            return false;
+    }
+
+    sqes_size_ = params.sq_entries * sizeof(struct io_uring_sqe);
+    sqes_ = (struct io_uring_sqe*)mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQES);
+    if(sqes_ == MAP_FAILED)
+        return false;
+
+    char* sq = (char*)sq_ptr_;
+    sq_head_ = (unsigned*)(sq + params.sq_off.head);
+    sq_tail_ = (unsigned*)(sq + params.sq_off.tail);
+    sq_mask_ = (unsigned*)(sq + params.sq_off.ring_mask);
+    sq_array_ = (unsigned*)(sq + params.sq_off.array);
+    sq_entries_ = params.sq_entries;
+
+    char* cq = (char*)cq_ptr_;
+    cq_head_ = (unsigned*)(cq + params.cq_off.head);
+    cq_tail_ = (unsigned*)(cq + params.cq_off.tail);
+    cq_mask_ = (unsigned*)(cq + params.cq_off.ring_mask);
+    cqes_ = (struct io_uring_cqe*)(cq + params.cq_off.cqes);
+    return true;
+}
+
+int UringPoller::Enter(unsigned to_submit, unsigned min_complete, unsigned flags, int time_out_ms){
+    syscall_count_++;
+    ACCOUNT_SYSCALL(AC_IO_URING_ENTER);
+    if(!(flags & IORING_ENTER_GETEVENTS)){
+        return syscall(__NR_io_uring_enter, ring_fd_, to_submit, 0, flags, nullptr, 0);
+    }
+
+    struct __kernel_timespec ts;
+    struct io_uring_getevents_arg arg;
+    memset(&arg, 0, sizeof(arg));
+    if(time_out_ms >= 0){
+        ts.tv_sec = time_out_ms / 1000;
+        ts.tv_nsec = (long long)(time_out_ms % 1000) * 1000000;
+        arg.ts = (uint64_t)(uintptr_t)&ts;
+    }
+    return syscall(__NR_io_uring_enter, ring_fd_, to_submit, min_complete,
+                    flags | IORING_ENTER_EXT_ARG, &arg, sizeof(arg));
+}
+
+UringPoller::FdState& UringPoller::GetState(int fd){
+    if((size_t)fd >= fds_.size()){
+        fds_.resize(fd * 2);
+    }
+    return fds_[fd];
+}
+
+// 需要持有锁，提交队列满了就先把积压的sqe提交掉
+struct io_uring_sqe* UringPoller::GetSqe(){
+    unsigned tail = *sq_tail_;
+    if(tail - __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE) >= sq_entries_){
+        int ret = Enter(to_submit_, 0, 0, -1);
+        if(ret > 0)
+            to_submit_ -= ret;
+        if(tail - __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE) >= sq_entries_)
+            return nullptr;
+    }
+
+    unsigned index = tail & *sq_mask_;
+    sq_array_[index] = index;
+    memset(&sqes_[index], 0, sizeof(struct io_uring_sqe));
+    return &sqes_[index];
+}
+
+// sqe填写完成后移动队尾，内核才能看到
+void UringPoller::Commit(){
+    __atomic_store_n(sq_tail_, *sq_tail_ + 1, __ATOMIC_RELEASE);
+    to_submit_++;
+}
+
+void UringPoller::PushPollAdd(int fd){
+    FdState& state = GetState(fd);
+    struct io_uring_sqe* sqe = GetSqe();
+    if(!sqe)
+        return;
+
+    state.gen++;
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = fd;
+    sqe->poll32_events = state.events & ~(EPOLLET | EPOLLONESHOT);
+    if((state.events & EPOLLET) && !(state.events & EPOLLONESHOT)){
+        sqe->len = IORING_POLL_ADD_MULTI;           // ET：一次提交，多次通知
+    }
+    sqe->user_data = UserData(state.gen, URING_POLL, fd);
+    Commit();
+    state.armed = true;
+    state.op = URING_POLL;
+}
+
+uint64_t UringPoller::UserData(uint32_t gen, uint8_t op, int fd){
+    return ((uint64_t)gen << 32) | ((uint64_t)op << 24) | ((uint32_t)fd & 0xffffff);
+}
+
+void UringPoller::PushPollRemove(int fd){
+    FdState& state = GetState(fd);
+    struct io_uring_sqe* sqe = GetSqe();
+    if(!sqe)
+        return;
+
+    sqe->opcode = IORING_OP_POLL_REMOVE;
+    sqe->fd = -1;
+    sqe->addr = UserData(state.gen, URING_POLL, fd);
+    sqe->user_data = REMOVE_USER_DATA;
+    Commit();
+    state.armed = false;
+}
+
+// 取消fd还在内核中的读写，被取消的操作以-ECANCELED完成，因为代数已经变了会被丢弃
+void UringPoller::PushCancel(int fd){
+    FdState& state = GetState(fd);
+    struct io_uring_sqe* sqe = GetSqe();
+    if(!sqe)
+        return;
+
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = -1;
+    sqe->addr = UserData(state.gen, state.op, fd);
+    sqe->user_data = REMOVE_USER_DATA;
+    Commit();
+    state.armed = false;
+}
+
+bool UringPoller::AddFd(int fd, uint32_t events){
+    if(fd < 0) return false;
+    std::lock_guard<std::mutex> lck(mtx_);
+    FdState& state = GetState(fd);
+    if(state.armed)
+        PushPollRemove(fd);
+    state.events = events;
+    state.registered = true;
+    PushPollAdd(fd);
+
+    if(std::this_thread::get_id() != loop_tid_){        // 其他线程的修改要立即生效
+        int ret = Enter(to_submit_, 0, 0, -1);
+        if(ret > 0) to_submit_ -= ret;
+    }
+    return true;
+}
+
+bool UringPoller::ModFd(int fd, uint32_t events){
+    if(fd < 0) return false;
+    std::lock_guard<std::mutex> lck(mtx_);
+    FdState& state = GetState(fd);
+    if(!state.registered)
+        return false;
+
+    if(state.armed)             // 单次poll触发之后已经不在内核中，只有还挂着的poll才需要先删除
+        PushPollRemove(fd);
+    state.events = events;
+    PushPollAdd(fd);
+
+    if(std::this_thread::get_id() != loop_tid_){
+        int ret = Enter(to_submit_, 0, 0, -1);
+        if(ret > 0) to_submit_ -= ret;
+    }
+    return true;
+}
+
+bool UringPoller::DelFd(int fd){
+    if(fd < 0) return false;
+    std::lock_guard<std::mutex> lck(mtx_);
+    FdState& state = GetState(fd);
+    if(!state.registered)
+        return false;
+
+    if(state.armed && state.op == URING_POLL)
+        PushPollRemove(fd);
+    else if(state.armed)
+        PushCancel(fd);
+    state.registered = false;
+    state.gen++;            // 之后到达的完成事件都视为过期
+
+    if(std::this_thread::get_id() != loop_tid_){
+        int ret = Enter(to_submit_, 0, 0, -1);
+        if(ret > 0) to_submit_ -= ret;
+    }
+    return true;
+}
+
+// 从完成队列取出事件，只在事件循环线程调用
+int UringPoller::Reap(){
+    std::lock_guard<std::mutex> lck(mtx_);
+    unsigned head = *cq_head_;
+    unsigned tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+    while(head != tail && event_cnt_ < events_.size()){
+        struct io_uring_cqe* cqe = &cqes_[head & *cq_mask_];
+        head++;
+        if(cqe->user_data == REMOVE_USER_DATA)
+            continue;
+
+        int fd = (int)(cqe->user_data & 0xffffff);
+        uint8_t op = (cqe->user_data >> 24) & 0xff;
+        uint32_t gen = cqe->user_data >> 32;
+        if((size_t)fd >= fds_.size())
+            continue;
+
+        FdState& state = fds_[fd];
+        if(!state.registered || state.gen != gen)       // 已经删除或者修改过的poll，或者连接关闭时取消的读写
+            continue;
+
+        bool more = cqe->flags & IORING_CQE_F_MORE;
+        if(!more)
+            state.armed = false;
+
+        if(op != URING_POLL){
+            Completion& event = events_[event_cnt_];
+            event.fd = fd;
+            event.op = op;
+            event.events = 0;
+            event.res = cqe->res;
+            if(op == URING_ACCEPT && !more){            // multishot被内核结束，或者单次accept完成，重新提交
+                bool unsupported = (cqe->res == -EINVAL && accept_multishot_);
+                if(unsupported)
+                    accept_multishot_ = false;
+                PushAccept(fd);
+                if(unsupported)
+                    continue;
+            }
+            event_cnt_++;
+            continue;
+        }
+
+        if(cqe->res >= 0){
+            events_[event_cnt_].fd = fd;
+            events_[event_cnt_].op = URING_POLL;
+            events_[event_cnt_].events = cqe->res;
+            event_cnt_++;
+        }
+
+        // LT需要继续通知，multishot被内核结束时也要重新提交，EPOLLONESHOT则等待ModFd
+        if(!more && !(state.events & EPOLLONESHOT))
+            PushPollAdd(fd);
+    }
+    __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+    return event_cnt_;
+}
+
+// 把积压的sqe和等待合并成一次系统调用
+int UringPoller::Wait(int time_out_ms){
+    event_cnt_ = 0;
+    Reap();
+
+    unsigned to_submit;
+    {
+        std::lock_guard<std::mutex> lck(mtx_);
+        to_submit = to_submit_;
+        to_submit_ = 0;
+    }
+    if(event_cnt_ > 0 && to_submit == 0)
+        return event_cnt_;
+
+    int ret;
+    if(event_cnt_ > 0){             // 已经有事件了，只提交不等待
+        ret = Enter(to_submit, 0, 0, -1);
+    }else{
+        ret = Enter(to_submit, 1, IORING_ENTER_GETEVENTS, time_out_ms);
+    }
+
+    int submitted = ret > 0 ? ret : 0;
+    if((unsigned)submitted < to_submit){            // 没有提交成功的留到下一次
+        std::lock_guard<std::mutex> lck(mtx_);
+        to_submit_ += to_submit - submitted;
+    }
+    if(ret < 0 && errno != ETIME && errno != EINTR && errno != EBUSY && event_cnt_ == 0)
+        return -1;
+
+    Reap();
+    return event_cnt_;
+}
+
+int UringPoller::GetEventFd(size_t i) const{
+    assert(i < event_cnt_);
+    return events_[i].fd;
+}
+
+uint32_t UringPoller::GetEvents(size_t i) const{
+    assert(i < event_cnt_);
+    return events_[i].events;
+}
+
+const char* UringPoller::Name() const{
+    return "io_uring";
+}
+
+uint64_t UringPoller::GetSyscallCount() const{
+    return syscall_count_.load();
+}
+
+int UringPoller::GetOp(size_t i) const{
+    assert(i < event_cnt_);
+    return events_[i].op;
+}
+
+int UringPoller::GetResult(size_t i) const{
+    assert(i < event_cnt_);
+    return events_[i].res;
+}
+
+// 完成模式下登记一个fd，之后可以对它提交读写。连接的fd复用时代数加一，旧连接残留的完成事件会被丢弃
+bool UringPoller::Attach(int fd){
+    if(fd < 0) return false;
+    std::lock_guard<std::mutex> lck(mtx_);
+    FdState& state = GetState(fd);
+    state.gen++;
+    state.events = 0;
+    state.registered = true;
+    state.armed = false;
+    return true;
+}
+
+// 需要持有锁。内核5.19开始支持multishot，一次提交持续接受新连接
+void UringPoller::PushAccept(int fd){
+    FdState& state = GetState(fd);
+    struct io_uring_sqe* sqe = GetSqe();
+    if(!sqe)
+        return;
+
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = fd;
+    sqe->accept_flags = SOCK_CLOEXEC;           // 不能带SOCK_NONBLOCK，非阻塞的socket在环里会直接返回-EAGAIN
+    if(accept_multishot_)
+        sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->user_data = UserData(state.gen, URING_ACCEPT, fd);
+    Commit();
+    state.armed = true;
+    state.op = URING_ACCEPT;
+}
+
+bool UringPoller::Accept(int listen_fd){
+    if(!Attach(listen_fd))
+        return false;
+    std::lock_guard<std::mutex> lck(mtx_);
+    PushAccept(listen_fd);
+    return true;
+}
+
+// 需要持有锁，填好的sqe带上fd当前的代数，其他线程的提交立即进入内核
+bool UringPoller::Submit(int fd, uint8_t op, struct io_uring_sqe* sqe){
+    FdState& state = GetState(fd);
+    sqe->fd = fd;
+    sqe->user_data = UserData(state.gen, op, fd);
+    Commit();
+    state.armed = true;
+    state.op = op;
+
+    if(std::this_thread::get_id() != loop_tid_){
+        int ret = Enter(to_submit_, 0, 0, -1);
+        if(ret > 0) to_submit_ -= ret;
+    }
+    return true;
+}
+
+// buf在完成之前不能被修改或者释放
+bool UringPoller::Recv(int fd, void* buf, size_t len){
+    if(fd < 0) return false;
+    std::lock_guard<std::mutex> lck(mtx_);
+    if(!GetState(fd).registered)
+        return false;
+    struct io_uring_sqe* sqe = GetSqe();
+    if(!sqe)
+        return false;
+
+    sqe->opcode = IORING_OP_RECV;
+    sqe->addr = (uint64_t)(uintptr_t)buf;
+    sqe->len = len;
+    return Submit(fd, URING_RECV, sqe);
+}
+
+// iov和它指向的数据在完成之前不能被修改或者释放。socket可能只写出一部分，由调用者提交剩下的
+bool UringPoller::Writev(int fd, const struct iovec* iov, int cnt){
+    if(fd < 0) return false;
+    std::lock_guard<std::mutex> lck(mtx_);
+    if(!GetState(fd).registered)
+        return false;
+    struct io_uring_sqe* sqe = GetSqe();
+    if(!sqe)
+        return false;
+
+    sqe->opcode = IORING_OP_WRITEV;
+    sqe->addr = (uint64_t)(uintptr_t)iov;
+    sqe->len = cnt;
+    return Submit(fd, URING_WRITEV, sqe);
+}
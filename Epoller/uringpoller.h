@@ -0,0 +1,113 @@
+#ifndef URINGPOLLER_H
+#define URINGPOLLER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <linux/io_uring.h>
+#include <mutex>
+#include <sys/epoll.h>
+#include <sys/uio.h>
+#include <thread>
+#include <vector>
+#include "poller.h"
+
+// 完成事件的类型，和fd、代数一起编码在user_data中: [代数:32][类型:8][fd:24]
+enum URING_OP{
+    URING_POLL = 0,         // 就绪通知，通过GetEvents取事件
+    URING_ACCEPT = 1,       // accept完成，GetResult为新连接的fd或者-errno
+    URING_RECV = 2,         // recv完成，GetResult为读到的字节数或者-errno
+    URING_WRITEV = 3        // writev完成，GetResult为写出的字节数或者-errno
+};
+
+// 基于io_uring的后端，直接使用系统调用，不依赖liburing。有两种用法：
+// 就绪模式用IORING_OP_POLL_ADD实现Poller接口：EPOLLONESHOT对应单次poll，ET对应multishot poll，LT则在每次完成后自动重新提交。
+// 完成模式由调用者直接提交accept/recv/writev，Wait返回的是操作的结果，读写不再需要单独的系统调用。
+// 完成模式下每个fd同时只有一个读或写在内核中，DelFd会取消它。
+// 事件循环线程发起的提交只写入提交队列，和下一次Wait合并成一次io_uring_enter；其他线程的提交立即生效
+class UringPoller : public Poller{
+public:
+    explicit UringPoller(int max_event = 1024);
+    ~UringPoller();
+
+    bool IsValid() const;
+
+    bool AddFd(int fd, uint32_t events) override;
+    bool ModFd(int fd, uint32_t events) override;
+    bool DelFd(int fd) override;
+    int Wait(int time_out_ms = -1) override;
+    int GetEventFd(size_t i) const override;
+    uint32_t GetEvents(size_t i) const override;
+    const char* Name() const override;
+    uint64_t GetSyscallCount() const override;
+
+    // 完成模式
+    bool Attach(int fd);
+    bool Accept(int listen_fd);
+    bool Recv(int fd, void* buf, size_t len);
+    bool Writev(int fd, const struct iovec* iov, int cnt);
+    int GetOp(size_t i) const;
+    int GetResult(size_t i) const;
+
+private:
+    // 每个fd的注册状态
+    struct FdState{
+        uint32_t events = 0;
+        uint32_t gen = 0;           // 每次提交poll加一，过期的完成事件直接丢弃
+        bool registered = false;
+        bool armed = false;         // 内核中是否还有这个fd的poll或者读写
+        uint8_t op = URING_POLL;    // 内核中的是哪种操作
+    };
+
+    // Wait取到的事件
+    struct Completion{
+        int fd;
+        uint8_t op;
+        uint32_t events;            // 就绪模式的事件
+        int res;                    // 完成模式的结果
+    };
+
+private:
+    bool Setup(unsigned entries);
+    struct io_uring_sqe* GetSqe();
+    void PushPollAdd(int fd);
+    void PushPollRemove(int fd);
+    void PushCancel(int fd);
+    void PushAccept(int fd);
+    bool Submit(int fd, uint8_t op, struct io_uring_sqe* sqe);
+    static uint64_t UserData(uint32_t gen, uint8_t op, int fd);
+    void Commit();
+    int Enter(unsigned to_submit, unsigned min_complete, unsigned flags, int time_out_ms);
+    int Reap();
+    FdState& GetState(int fd);
+
+private:
+    int ring_fd_;
+    unsigned* sq_head_;
+    unsigned* sq_tail_;
+    unsigned* sq_mask_;
+    unsigned* sq_array_;
+    unsigned sq_entries_;
+    struct io_uring_sqe* sqes_;
+    unsigned* cq_head_;
+    unsigned* cq_tail_;
+    unsigned* cq_mask_;
+    struct io_uring_cqe* cqes_;
+
+    void* sq_ptr_;
+    size_t sq_size_;
+    void* cq_ptr_;
+    size_t cq_size_;
+    size_t sqes_size_;
+
+    std::mutex mtx_;                    // 保护提交队列和fd状态
+    unsigned to_submit_;                // 事件循环线程写入、还没提交的sqe数量
+    std::thread::id loop_tid_;
+    std::vector<FdState> fds_;
+    bool accept_multishot_;             // 内核不支持multishot accept(5.19)时每次完成后重新提交
+    std::vector<Completion> events_;
+    size_t event_cnt_;
+    std::atomic<uint64_t> syscall_count_;
+};
+
+#endif
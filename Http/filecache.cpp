@@ -0,0 +1,243 @@
+#include "filecache.h"
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <zlib.h>
+#include "../Log/log.h"
+
+FileCache::FileCache() :
+    max_file_size_(0),
+    capacity_(0),
+    bytes_(0),
+    is_open_(false),
+    hit_count_(0),
+    miss_count_(0)
+{
+
+}
+
+FileCache& FileCache::Instance(){
+    static FileCache ins;
+    return ins;
+}
+
+void FileCache::Init(std::size_t max_file_size, std::size_t capacity){
+    assert(max_file_size > 0 && capacity >= max_file_size);
+    max_file_size_ = max_file_size;
+    capacity_ = capacity;
+    is_open_.store(true);
+}
+
+bool FileCache::IsOpen(){
+    return is_open_.load();
+}
+
+// 只查内存，不做任何I/O。没有缓存或者到了该校验的时候返回空
+std::shared_ptr<const CachedFile> FileCache::Find(const std::string& file){
+    auto now = std::chrono::steady_clock::now();
+    std::lock_guard<std::mutex> lck(mtx_);
+    auto it = files_.find(file);
+    if(it == files_.end() || now - it->second.checked > std::chrono::milliseconds(FILE_CACHE_CHECK_MS))
+        return nullptr;
+
+    lru_.splice(lru_.begin(), lru_, it->second.pos);
+    return it->second.file;
+}
+
+// 返回文件内容，文件不存在、不是普通文件或者太大不缓存时返回空，由调用者走原来的mmap
+std::shared_ptr<const CachedFile> FileCache::Get(const std::string& file){
+    std::shared_ptr<const CachedFile> cached = Find(file);
+    if(cached){
+        hit_count_++;
+        return cached;
+    }
+
+    struct stat st;
+    if(stat(file.c_str(), &st) < 0 || !S_ISREG(st.st_mode) || (std::size_t)st.st_size > max_file_size_){
+        Erase(file);
+        miss_count_++;
+        return nullptr;
+    }
+
+    {
+        // 过了校验时间但是文件没变，只更新校验时间
+        std::lock_guard<std::mutex> lck(mtx_);
+        auto it = files_.find(file);
+        if(it != files_.end() && it->second.file->st.st_mtime == st.st_mtime && it->second.file->st.st_size == st.st_size){
+            it->second.checked = std::chrono::steady_clock::now();
+            lru_.splice(lru_.begin(), lru_, it->second.pos);
+            hit_count_++;
+            return it->second.file;
+        }
+    }
+
+    miss_count_++;
+    cached = Load(file, st);
+    if(cached){
+        Insert(file, cached);
+    }
+    return cached;
+}
+
+// 把整个文件读进内存，读取的长度和stat不一致说明文件正在被修改，这次不缓存
+std::shared_ptr<CachedFile> FileCache::Load(const std::string& file, const struct stat& st){
+    int fd = open(file.c_str(), O_RDONLY | O_CLOEXEC);
+    if(fd < 0)
+        return nullptr;
+
+    std::shared_ptr<CachedFile> cached = std::make_shared<CachedFile>();
+    cached->st = st;
+    cached->data.resize(st.st_size);
+    std::size_t total = 0;
+    while(total < cached->data.size()){
+        ssize_t len = read(fd, &cached->data[total], cached->data.size() - total);
+        if(len < 0 && errno == EINTR)
+            continue;
+        if(len <= 0)
+            break;
+        total += len;
+    }
+    close(fd);
+
+    if(total != cached->data.size()){
+        LOG_WARN("FileCache load %s short read: %d/%d", file.c_str(), (int)total, (int)cached->data.size());
+        return nullptr;
+    }
+    return cached;
+}
+
+// 缓存键加上不会出现在路径里的后缀，避免和直接请求.gz文件的缓存项混在一起
+std::string FileCache::GzipKey(const std::string& file){
+    return file + "\ngzip";
+}
+
+// 只查内存：gzip版本(包括不值得压缩的结论)已经缓存、不用校验并且对应当前的原文件。
+// 这时GetGzip不会做任何I/O和压缩
+bool FileCache::FindGzip(const std::string& file, const struct stat& src){
+    std::shared_ptr<const CachedFile> cached = Find(GzipKey(file));
+    return cached && cached->src_mtime == src.st_mtime && cached->src_size == src.st_size;
+}
+
+// 返回文件的gzip版本，原文件的信息由调用者stat得到。没有.gz并且压缩效果不好(省不到10%)、
+// 压缩后还是太大时返回空，这个结果也会缓存，不会每次请求都重新压缩。
+// 同一个请求取原文件时已经计过命中，这里命中不再计数，只有重新读.gz或者压缩时计一次未命中
+std::shared_ptr<const CachedFile> FileCache::GetGzip(const std::string& file, const struct stat& src){
+    std::string key = GzipKey(file);
+    std::string sidecar = file + ".gz";
+    std::shared_ptr<const CachedFile> cached = Find(key);
+    if(cached && cached->src_mtime == src.st_mtime && cached->src_size == src.st_size){
+        return cached->data.empty() ? nullptr : cached;
+    }
+
+    struct stat st;
+    bool has_sidecar = stat(sidecar.c_str(), &st) == 0 && S_ISREG(st.st_mode) && st.st_mtime >= src.st_mtime &&
+                        (std::size_t)st.st_size <= max_file_size_;
+    {
+        // 过了校验时间，但原文件和.gz都没变，只更新校验时间
+        std::lock_guard<std::mutex> lck(mtx_);
+        auto it = files_.find(key);
+        if(it != files_.end()){
+            const CachedFile& old = *it->second.file;
+            bool same = old.src_mtime == src.st_mtime && old.src_size == src.st_size && old.is_sidecar == has_sidecar &&
+                        (!has_sidecar || (old.st.st_mtime == st.st_mtime && old.st.st_size == st.st_size));
+            if(same){
+                it->second.checked = std::chrono::steady_clock::now();
+                lru_.splice(lru_.begin(), lru_, it->second.pos);
+                return old.data.empty() ? nullptr : it->second.file;
+            }
+        }
+    }
+
+    miss_count_++;
+    std::shared_ptr<CachedFile> variant;
+    if(has_sidecar){
+        variant = Load(sidecar, st);
+        if(!variant)
+            return nullptr;
+        variant->is_sidecar = true;
+    }else{
+        if((std::size_t)src.st_size > GZIP_MAX_SOURCE)
+            return nullptr;
+        std::shared_ptr<const CachedFile> original = (std::size_t)src.st_size <= max_file_size_ ? Get(file) : Load(file, src);
+        if(!original)
+            return nullptr;
+        variant = std::make_shared<CachedFile>();
+        variant->st = original->st;
+        if(!Compress(original->data, &variant->data) || variant->data.size() > max_file_size_ ||
+                variant->data.size() * 10 > original->data.size() * 9){
+            variant->data.clear();
+        }
+        variant->st.st_size = variant->data.size();
+        LOG_DEBUG("FileCache gzip %s: %d -> %d", file.c_str(), (int)original->data.size(), (int)variant->data.size());
+    }
+    variant->src_mtime = src.st_mtime;
+    variant->src_size = src.st_size;
+    Insert(key, variant);
+    return variant->data.empty() ? nullptr : variant;
+}
+
+// 压缩成gzip格式，只在每个文件第一次被请求时执行一次，用最高压缩级别
+bool FileCache::Compress(const std::string& in, std::string* out){
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    if(deflateInit2(&zs, Z_BEST_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)     // 15+16: gzip头
+        return false;
+    out->resize(deflateBound(&zs, in.size()));
+    zs.next_in = (Bytef*)in.data();
+    zs.avail_in = in.size();
+    zs.next_out = (Bytef*)&(*out)[0];
+    zs.avail_out = out->size();
+    int ret = deflate(&zs, Z_FINISH);
+    out->resize(zs.total_out);
+    deflateEnd(&zs);
+    return ret == Z_STREAM_END;
+}
+
+void FileCache::Insert(const std::string& file, const std::shared_ptr<const CachedFile>& cached){
+    std::lock_guard<std::mutex> lck(mtx_);
+    auto it = files_.find(file);
+    if(it != files_.end()){
+        bytes_ -= it->second.file->data.size();
+        lru_.splice(lru_.begin(), lru_, it->second.pos);
+    }else{
+        lru_.push_front(file);
+        it = files_.emplace(file, Node()).first;
+        it->second.pos = lru_.begin();
+    }
+    it->second.file = cached;
+    it->second.checked = std::chrono::steady_clock::now();
+    bytes_ += cached->data.size();
+
+    // 超过容量就从最久没访问的开始淘汰，正在发送的响应持有shared_ptr，不受影响
+    while(bytes_ > capacity_ && lru_.size() > 1){
+        auto victim = files_.find(lru_.back());
+        bytes_ -= victim->second.file->data.size();
+        files_.erase(victim);
+        lru_.pop_back();
+    }
+}
+
+void FileCache::Erase(const std::string& file){
+    std::lock_guard<std::mutex> lck(mtx_);
+    auto it = files_.find(file);
+    if(it == files_.end())
+        return;
+    bytes_ -= it->second.file->data.size();
+    lru_.erase(it->second.pos);
+    files_.erase(it);
+}
+
+uint64_t FileCache::GetHitCount() const{
+    return hit_count_.load();
+}
+
+uint64_t FileCache::GetMissCount() const{
+    return miss_count_.load();
+}
+
+std::size_t FileCache::GetBytes(){
+    std::lock_guard<std::mutex> lck(mtx_);
+    return bytes_;
+}
@@ -0,0 +1,75 @@
+#ifndef FILECACHE_H
+#define FILECACHE_H
+#include "../common/nocopy.h"
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <sys/stat.h>
+#include <unordered_map>
+
+constexpr int FILE_CACHE_CHECK_MS = 1000;       // 缓存项超过这个时间没有校验，就要重新stat看文件有没有变化
+constexpr std::size_t GZIP_MAX_SOURCE = 4 * 1024 * 1024;        // 超过这个大小的文件不在内存中压缩，只用预压缩的.gz
+
+// 缓存的静态文件
+struct CachedFile{
+    std::string data;
+    struct stat st;
+    // 以下只用于压缩版本：对应的原文件，原文件变化后要重新生成
+    bool is_sidecar = false;            // 来自磁盘上预压缩的.gz，否则是在内存中压缩的
+    time_t src_mtime = 0;
+    off_t src_size = 0;
+};
+
+// 小静态文件的内存缓存，按总字节数做LRU淘汰。
+// Get在未命中或者需要校验时会读文件，只能在工作线程调用；Find/FindGzip只查内存，事件循环线程用它们判断能不能直接处理请求。
+// 文件的gzip版本以"文件名.gz"为键和原文件一起缓存，优先用磁盘上的.gz，没有就压缩一次，同样计入容量和LRU
+class FileCache : public NoCopy{
+public:
+    static FileCache& Instance();
+
+    void Init(std::size_t max_file_size, std::size_t capacity);
+    bool IsOpen();
+    std::shared_ptr<const CachedFile> Get(const std::string& file);
+    std::shared_ptr<const CachedFile> Find(const std::string& file);
+    std::shared_ptr<const CachedFile> GetGzip(const std::string& file, const struct stat& src);
+    bool FindGzip(const std::string& file, const struct stat& src);
+
+    uint64_t GetHitCount() const;
+    uint64_t GetMissCount() const;
+    std::size_t GetBytes();
+
+private:
+    struct Node{
+        std::shared_ptr<const CachedFile> file;
+        std::chrono::steady_clock::time_point checked;      // 上次校验的时间
+        std::list<std::string>::iterator pos;               // 在lru_中的位置
+    };
+
+private:
+    FileCache();
+    ~FileCache() = default;
+    std::shared_ptr<CachedFile> Load(const std::string& file, const struct stat& st);
+    static bool Compress(const std::string& in, std::string* out);
+    static std::string GzipKey(const std::string& file);
+    void Insert(const std::string& file, const std::shared_ptr<const CachedFile>& cached);
+    void Erase(const std::string& file);
+
+private:
+    std::size_t max_file_size_;
+    std::size_t capacity_;
+    std::size_t bytes_;
+    std::atomic_bool is_open_;
+    std::atomic<uint64_t> hit_count_;
+    std::atomic<uint64_t> miss_count_;
+
+    std::mutex mtx_;
+    std::list<std::string> lru_;            // 表头是最近访问的文件
+    std::unordered_map<std::string, Node> files_;
+};
+
+#endif
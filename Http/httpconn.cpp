@@ -2,23 +2,64 @@
 #include <arpa/inet.h>
 #include <cassert>
 #include <cerrno>
+#include <chrono>
 #include <cstddef>
 #include <cstdint>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
 #include <sys/types.h>
 #include <sys/uio.h>
 #include <unistd.h>
+#include "../Capture/capture.h"
 #include "../Log/log.h"
+#include "../Metrics/accounting.h"
+#include "../Metrics/metrics.h"
+#include "../Trace/trace.h"
+#include "probes.h"
+#include "filecache.h"
+#include "sessionstore.h"
 
 const char* HttpConn::src_dir_;
 std::atomic_int HttpConn::user_count_;
-bool HttpConn::is_Et_;
+bool HttpConn::is_cork_ = false;
+bool HttpConn::is_metrics_ = false;
+bool HttpConn::is_trace_dump_ = false;
+int HttpConn::header_timeout_ms_ = 0;
+int HttpConn::body_timeout_ms_ = 0;
+int HttpConn::idle_timeout_ms_ = 0;
+int HttpConn::write_timeout_ms_ = 0;
+int HttpConn::max_requests_ = 0;
+std::size_t HttpConn::io_budget_ = 0;
+std::size_t HttpConn::max_header_bytes_ = 0;
+std::size_t HttpConn::max_body_bytes_ = 0;
+std::atomic<uint64_t> HttpConn::yield_count_(0);
+std::mutex HttpConn::shortened_mutex_;
+std::vector<int> HttpConn::shortened_;
 
 HttpConn::HttpConn() :
     fd_(-1),
     addr_({0}),
-    is_close_(false)
+    is_close_(false),
+    is_corked_(false),
+    owner_state_(0),
+    deadline_ms_(0),
+    armed_ms_(0),
+    phase_(PHASE_IDLE),
+    reject_code_(0),
+    request_count_(0),
+    keep_alive_(false),
+    yield_events_(0),
+    request_start_us_(0),
+    trace_id_(0),
+    queued_us_(0),
+    queued_phase_(TP_QUEUE),
+    response_bytes_(0),
+    capture_id_(0),
+    iov_cnt_(0)
 {
+    iov_[0].iov_len = iov_[1].iov_len = 0;
 
 }
 
@@ -42,16 +83,38 @@ void HttpConn::Init(int fd, const sockaddr_in& addr){
     fd_ = fd;
     write_buff_.RetrieveAll();
     read_buff_.RetrieveAll();
+    iov_[0].iov_len = iov_[1].iov_len = 0;
+    iov_cnt_ = 0;
+    owner_state_.store(0);
     is_close_ = false;
+    is_corked_ = false;
+    request_count_ = 0;
+    keep_alive_ = false;
+    reject_code_ = 0;
+    yield_events_ = 0;
+    request_start_us_ = 0;
+    trace_id_ = Trace::IsOpen() ? Trace::NewId() : 0;
+    queued_us_ = 0;
+    response_bytes_ = 0;
+    capture_id_ = Capture::IsOpen() ? Capture::Instance().Open() : 0;
+    armed_ms_.store(0);             // 还没加入定时器，加入时按这个期限设置
+    SetPhase(PHASE_IDLE, header_timeout_ms_);       // 新连接要在请求头超时内发来第一个请求
+    TW_PROBE3(conn__accept, fd_, addr_.sin_addr.s_addr, ntohs(addr_.sin_port));
     LOG_INFO("Client[%d](%s:%d) in, userCount:%d", fd_, GetIp(), GetPort(), user_count_.load());
 }
 
 // 关闭http处理
 void HttpConn::Close(){
+    ACCOUNT_PHASE(AP_CLOSE);
     response_.UnmapFile();
     if(is_close_ == false){
         is_close_ = true;
         user_count_.fetch_sub(1);
+        TW_PROBE2(conn__close, fd_, request_count_);
+        if(capture_id_ && Capture::IsOpen()){           // 能读到EOF说明客户端先关闭，回放时由客户端关闭
+            char c;
+            Capture::Instance().Closed(capture_id_, recv(fd_, &c, 1, MSG_PEEK | MSG_DONTWAIT) == 0);
+        }
         close(fd_);
         LOG_INFO("Client[%d](%s:%d) quit, UserCount:%d", fd_, GetIp(), GetPort(), user_count_.load());
     }
@@ -69,23 +132,203 @@ int HttpConn::ToWriteBytes(){
     return iov_[0].iov_len + iov_[1].iov_len;
 }
 
+// 记录到达的事件，连接没有被持有则由调用者持有并返回true，否则由当前持有者处理这些事件
+bool HttpConn::Acquire(uint32_t events){
+    uint32_t prev = owner_state_.fetch_or(events | CONN_OWNED);
+    return !(prev & CONN_OWNED);
+}
+
+// 取出持有期间到达的事件，继续保持持有
+uint32_t HttpConn::TakeEvents(){
+    return owner_state_.fetch_and(CONN_OWNED) & ~CONN_OWNED;
+}
+
+// 没有新事件才能释放，返回false说明期间又有事件到达，持有者需要继续处理
+bool HttpConn::Release(){
+    uint32_t expected = CONN_OWNED;
+    return owner_state_.compare_exchange_strong(expected, 0);
+}
+
+// 缓冲区里是一个完整的静态文件GET，并且文件已经在缓存中，事件循环线程可以直接处理，不会阻塞
+bool HttpConn::CanInline(){
+    std::string path;
+    bool accept_gzip = false;
+    if(!HttpRequest::PeekStaticPath(read_buff_, &path, &accept_gzip))
+        return false;
+
+    std::shared_ptr<const CachedFile> file = FileCache::Instance().Find(src_dir_ + path);
+    if(!file || !(file->st.st_mode & S_IROTH))
+        return false;
+    // 要发送gzip版本时，压缩版本也要已经缓存，否则生成响应时会stat .gz、读文件甚至压缩
+    if(accept_gzip && HttpResponse::IsCompressible(path, file->st.st_size))
+        return FileCache::Instance().FindGzip(src_dir_ + path, file->st);
+    return true;
+}
+
+bool HttpConn::HasRequest() const{
+    return read_buff_.ReadableBytes() > 0;
+}
+
+// 持有者让出线程前把没处理完的事件放回去，重新排队后由TakeEvents取出
+void HttpConn::Requeue(uint32_t events){
+    owner_state_.fetch_or(events);
+}
+
+// 取出因为预算用完而没处理完的方向
+uint32_t HttpConn::TakeYield(){
+    uint32_t events = yield_events_;
+    yield_events_ = 0;
+    return events;
+}
+
+// 交给线程池或者数据库线程前记下时间，开始处理时记录排队时长
+void HttpConn::TraceQueued(int phase){
+    if(Trace::IsOpen()){
+        queued_us_ = Trace::NowUs();
+        queued_phase_ = phase;
+    }
+}
+
+void HttpConn::TraceDequeued(){
+    if(queued_us_ > 0){
+        Trace::Record(trace_id_, (TRACE_PHASE)queued_phase_, queued_us_, Trace::NowUs());
+        queued_us_ = 0;
+    }
+}
+
+bool HttpConn::IsClose() const{
+    return is_close_;
+}
+
 // 解析请求报文，生成回应报文
 bool HttpConn::process(){
+    ACCOUNT_PHASE(AP_PARSE);
     request_.Init();
     if(read_buff_.ReadableBytes() <= 0){            // 如果没有request报文需要解析
         return false;
-    }else if(request_.Parse(read_buff_)){       // 如果解析成功
+    }else if(!CheckRequest()){              // 请求还没收完整，等待更多数据
+        return false;
+    }
+
+    if(reject_code_ != 0){          // 请求头或者请求体超过上限，回应后关闭连接，缓冲区里剩下的字节无法再分出请求
+        Metrics::Add(MC_PARSE_ERROR);
+        keep_alive_ = false;
+        read_buff_.RetrieveAll();
+        response_.Init(src_dir_, request_.path(), false, reject_code_);
+        if(reject_code_ == 413){
+            response_.SetBody("413 : Payload Too Large\n");
+        }
+        reject_code_ = 0;
+        MakeResponse();
+        return true;
+    }
+
+    int64_t parse_us = Trace::IsOpen() ? Trace::NowUs() : 0;
+    bool parsed = request_.Parse(read_buff_);
+    if(parse_us > 0){
+        Trace::Record(trace_id_, TP_PARSE, parse_us, Trace::NowUs());
+    }
+
+    if(parsed){       // 如果解析成功
         LOG_DEBUG("%s", request_.path().c_str());
-        response_.Init(src_dir_, request_.path(), request_.IsKeepAlive(), 200);
+        TW_PROBE3(request__parsed, fd_, request_.method().c_str(), request_.path().c_str());
+        if(request_.IsPendingVerify()){         // 需要查询数据库，先挂起，等数据库线程调用ProcessSql后再生成响应
+            return false;
+        }
+        NextKeepAlive();
+        response_.Init(src_dir_, request_.path(), keep_alive_, 200);
+        response_.SetKeepAlive(max_requests_ > 0 ? max_requests_ - request_count_ : 0, idle_timeout_ms_ / 1000);
+        response_.SetAcceptGzip(request_.AcceptsGzip());
+        if(is_metrics_ && request_.path() == METRICS_PATH){
+            response_.SetBody(Metrics::Instance().Render());
+        }else if(is_trace_dump_ && request_.path() == TRACE_PATH){
+            response_.SetBody(Trace::Instance().Dump());
+        }
     }else{      // 如果有报文需要解析，但是解析失败
+        Metrics::Add(MC_PARSE_ERROR);
+        keep_alive_ = false;
         response_.Init(src_dir_, request_.path(), false, 400);
     }
 
+    MakeResponse();
+    return true;
+}
+
+// 检查请求是否收完整，并推进对应阶段的期限。请求头的期限从收到第一个字节开始算，请求体的期限从收完请求头开始算，
+// 之后收到数据都不顺延，慢慢发送的客户端占不住连接。超过上限的请求返回true，由process回应错误
+bool HttpConn::CheckRequest(){
+    if(phase_.load() == PHASE_IDLE && request_start_us_ == 0){
+        request_start_us_ = Metrics::NowUs();
+    }
+    HttpRequest::RECV_STATE state = HttpRequest::CheckComplete(read_buff_, max_header_bytes_, max_body_bytes_);
+    if(state == HttpRequest::RECV_HEADER){
+        if(phase_.load() == PHASE_IDLE){
+            int64_t deadline = NowMs() + header_timeout_ms_;
+            // 第一个请求的期限从连接建立时就开始算，keep-alive上后面的请求从收到第一个字节开始算
+            if(request_count_ == 0 && (header_timeout_ms_ <= 0 || deadline > deadline_ms_.load()))
+                deadline = deadline_ms_.load();
+            phase_.store(PHASE_HEADER);
+            SetDeadline(deadline);
+        }
+        return false;
+    }
+
+    if(state == HttpRequest::RECV_BODY){
+        if(phase_.load() != PHASE_BODY){
+            SetPhase(PHASE_BODY, body_timeout_ms_);
+        }
+        return false;
+    }
+
+    if(state == HttpRequest::RECV_BAD || state == HttpRequest::RECV_TOO_LARGE){
+        reject_code_ = state == HttpRequest::RECV_BAD ? 400 : 413;
+    }
+
+    SetPhase(PHASE_PROCESS, write_timeout_ms_);         // 处理请求和等待数据库也不能无限期占用连接
+    return true;
+}
+
+// 处理完一个请求后是否还保持连接，达到单连接请求数上限就在这次响应后关闭
+void HttpConn::NextKeepAlive(){
+    request_count_++;
+    keep_alive_ = request_.IsKeepAlive() && (max_requests_ <= 0 || request_count_ < max_requests_);
+}
+
+bool HttpConn::IsPendingSql() const{
+    return request_.IsPendingVerify();
+}
+
+// 在数据库线程中完成挂起的校验，然后生成响应报文
+void HttpConn::ProcessSql(){
+    ACCOUNT_PHASE(AP_SQL);
+    int64_t verify_us = Trace::IsOpen() ? Trace::NowUs() : 0;
+    request_.Verify();
+    if(verify_us > 0){
+        Trace::Record(trace_id_, TP_VERIFY, verify_us, Trace::NowUs());
+    }
+    NextKeepAlive();
+    response_.Init(src_dir_, request_.path(), keep_alive_, 200);
+    response_.SetKeepAlive(max_requests_ > 0 ? max_requests_ - request_count_ : 0, idle_timeout_ms_ / 1000);
+    response_.SetAcceptGzip(request_.AcceptsGzip());
+    if(!request_.NewSession().empty()){         // 登录成功，下发会话cookie
+        response_.SetCookie("sid", request_.NewSession(), SessionStore::Instance().GetTtlMs() / 1000);
+    }
+    MakeResponse();
+}
+
+void HttpConn::MakeResponse(){
     // 生成响应报文
+    ACCOUNT_PHASE(AP_RESPONSE);
+    int64_t response_us = Trace::IsOpen() ? Trace::NowUs() : 0;
     response_.MakeResponse(write_buff_);    
+    if(response_us > 0){
+        Trace::Record(trace_id_, TP_RESPONSE, response_us, Trace::NowUs());
+    }
+    Metrics::Request(response_.GetCode(), response_.GetFileType());
 
     iov_[0].iov_base = (char*)(write_buff_.Peek());     // 获取响应保存存储指针
     iov_[0].iov_len = write_buff_.ReadableBytes();      // 响应报文长度
+    iov_[1].iov_len = 0;            // 清掉上一个响应残留的文件长度
     iov_cnt_ = 1;
 
     // 如果是纯纯一点文件都读不出来，这样会生成提示错误报文，这时候就不需要读取html，而是仅仅需要获取buffer中的内容即可
@@ -95,52 +338,218 @@ bool HttpConn::process(){
         iov_[1].iov_len = response_.GetFileLen();
         iov_cnt_ = 2;
     }
+    response_bytes_ = ToWriteBytes();
+    TW_PROBE3(response__start, fd_, response_.GetCode(), response_bytes_);
     LOG_DEBUG("filesize:%d, %d  to %d", response_.GetFileLen() , iov_cnt_, ToWriteBytes());
-    return true;
 }
 
 // 读取socket中的请求报文
+template<bool IS_ET>
 ssize_t HttpConn::read(int* save_errno){
+    ACCOUNT_PHASE(AP_READ);
     ssize_t len = -1;
+    std::size_t total = 0;
+    int64_t trace_us = Trace::IsOpen() ? Trace::NowUs() : 0;
+    std::size_t readable = read_buff_.ReadableBytes();         // 本次读到的字节接在原有数据之后
     do{
         len = read_buff_.ReadFd(fd_,save_errno);
         if(len <= 0)
             break;
-    }while(is_Et_);         // is_Et:边沿触发，要一次性全部读取,因为ET触发同一事件只会触发一次，所以要在本次中读取完所有的报文
 
+        total += len;
+        if(io_budget_ > 0 && total >= io_budget_){         // 这次事件的预算用完了，让出线程，剩下的数据之后再读
+            yield_events_ |= EPOLLIN;
+            yield_count_++;
+            break;
+        }
+    }while(IS_ET);         // 边沿触发，要一次性全部读取,因为ET触发同一事件只会触发一次，所以要在本次中读取完所有的报文
+
+    ReadDone(readable, total, trace_us);
     return len;
 }
 
+// 读到的字节接在原来的readable字节之后
+void HttpConn::ReadDone(std::size_t readable, std::size_t total, int64_t trace_us){
+    if(trace_us > 0 && total > 0){
+        Trace::Record(trace_id_, TP_READ, trace_us, Trace::NowUs());
+    }
+    if(capture_id_ && total > 0 && Capture::IsOpen()){
+        Capture::Instance().Data(capture_id_, read_buff_.Peek() + readable, total);
+    }
+}
+
+// 留出接收的空间，提交的recv直接写进读缓冲区，完成之前不能再动缓冲区
+char* HttpConn::RecvBuffer(std::size_t* len){
+    read_buff_.EnsureWritable(RECV_SIZE);
+    *len = read_buff_.WritableBytes();
+    return read_buff_.BeginWrite();
+}
+
+void HttpConn::Received(std::size_t len){
+    ACCOUNT_PHASE(AP_READ);
+    std::size_t readable = read_buff_.ReadableBytes();
+    read_buff_.HasWritten(len);
+    ReadDone(readable, len, Trace::IsOpen() ? Trace::NowUs() : 0);       // 读取发生在内核中，只记录完成的时间点
+}
+
+// 两种触发模式各实例化一份，循环条件在编译期确定
+template ssize_t HttpConn::read<true>(int* save_errno);
+template ssize_t HttpConn::read<false>(int* save_errno);
+
 // 将回应报文写入socket
+template<bool IS_ET>
 ssize_t HttpConn::write(int* save_errno){
+    ACCOUNT_PHASE(AP_WRITE);
     ssize_t len = -1;
+    std::size_t total = 0;
+    int64_t trace_us = Trace::IsOpen() ? Trace::NowUs() : 0;
     do{
         len = writev(fd_, iov_, iov_cnt_);
         if(len <=0){
             *save_errno = errno;
             break;
         }
+        total += len;
 
         if(iov_[0].iov_len + iov_[1].iov_len == 0) break;       // 传输结束
-        else if ((size_t)len > iov_[0].iov_len){            // 如果写入长度大于iov[0]的内容长度，则说明iov[1]中的内容也被写入了一部分，所以需要动态调整
-            iov_[1].iov_base = (uint8_t*)iov_[1].iov_base + (len - iov_[0].iov_len);    // 移动读指针偏移量
-            iov_[1].iov_len -= (len - iov_[0].iov_len);
+        Advance(len);
 
-            if(iov_[0].iov_len){
-                write_buff_.RetrieveAll();
-                iov_[0].iov_len = 0;
-            }
-        }else{      // 如果写入长度小于iov[0]的长度，则需要动态调整iov[0]的待写长度
-            iov_[0].iov_base = (uint8_t*)iov_[0].iov_base + len;
-            iov_[0].iov_len -= len;
-            write_buff_.Retrieve(len);
+        // 一次没写完，剩下的要分几次发送，加塞让剩余的头部和文件凑成整段再发
+        if(is_cork_ && !is_corked_ && ToWriteBytes() > 0){
+            SetSockCork(true);
+        }
+
+        if(io_budget_ > 0 && total >= io_budget_ && ToWriteBytes() > 0){      // 大文件不能一直占着线程
+            yield_events_ |= EPOLLOUT;
+            yield_count_++;
+            break;
         }
+    }while(IS_ET || ToWriteBytes() > 10240);
 
-    }while(is_Et_ || ToWriteBytes() > 10240);
+    if(is_corked_ && ToWriteBytes() == 0){          // 写完后拔塞，把最后不满一段的数据立即发出
+        SetSockCork(false);
+    }
 
+    WriteDone(total, trace_us);
     return len;
 }
 
+template ssize_t HttpConn::write<true>(int* save_errno);
+template ssize_t HttpConn::write<false>(int* save_errno);
+
+// 按写出的字节数移动iov
+void HttpConn::Advance(std::size_t len){
+    if(len > iov_[0].iov_len){            // 如果写入长度大于iov[0]的内容长度，则说明iov[1]中的内容也被写入了一部分，所以需要动态调整
+        iov_[1].iov_base = (uint8_t*)iov_[1].iov_base + (len - iov_[0].iov_len);    // 移动读指针偏移量
+        iov_[1].iov_len -= (len - iov_[0].iov_len);
+
+        if(iov_[0].iov_len){
+            write_buff_.RetrieveAll();
+            iov_[0].iov_len = 0;
+        }
+    }else{      // 如果写入长度小于iov[0]的长度，则需要动态调整iov[0]的待写长度
+        iov_[0].iov_base = (uint8_t*)iov_[0].iov_base + len;
+        iov_[0].iov_len -= len;
+        write_buff_.Retrieve(len);
+    }
+}
+
+// 完成模式下提交的writev直接使用连接的iov，完成之前不能修改
+const struct iovec* HttpConn::WriteIov(int* cnt) const{
+    *cnt = iov_cnt_;
+    return iov_;
+}
+
+void HttpConn::Sent(std::size_t len){
+    ACCOUNT_PHASE(AP_WRITE);
+    Advance(len);
+    WriteDone(len, Trace::IsOpen() ? Trace::NowUs() : 0);
+}
+
+// 统计写出的字节，响应写完时结束这个请求并进入keep-alive空闲，否则推进写期限
+void HttpConn::WriteDone(std::size_t total, int64_t trace_us){
+    Metrics::Add(MC_BYTES_SENT, total);
+    int64_t now_us = (trace_us > 0 || request_start_us_ > 0) ? Metrics::NowUs() : 0;
+    if(trace_us > 0 && total > 0){
+        Trace::Record(trace_id_, TP_WRITE, trace_us, now_us);
+    }
+    if(ToWriteBytes() == 0){
+        if(response_bytes_ > 0){
+            TW_PROBE3(response__done, fd_, response_.GetCode(), response_bytes_);
+            response_bytes_ = 0;
+            ACCOUNT_REQUEST();
+        }
+        if(request_start_us_ > 0){
+            Metrics::Observe(MH_REQUEST, now_us - request_start_us_);
+            if(trace_us > 0){
+                Trace::Finish(trace_id_, request_start_us_, now_us);
+                trace_id_ = Trace::NewId();
+            }
+            request_start_us_ = 0;
+        }
+        SetPhase(PHASE_IDLE, idle_timeout_ms_);         // 响应写完，进入keep-alive空闲
+    }else if(total > 0 || phase_.load() != PHASE_WRITE){
+        SetPhase(PHASE_WRITE, write_timeout_ms_);       // 写超时从上一次写出数据开始算
+    }
+}
+
+// 进入新的阶段，期限为现在加上这个阶段的超时，超时为0表示不限制
+void HttpConn::SetPhase(int phase, int timeout_ms){
+    phase_.store(phase);
+    SetDeadline(timeout_ms > 0 ? NowMs() + timeout_ms : INT64_MAX);
+}
+
+// 更新期限。定时器只在到期时才按推后的期限重新加入，期限提前时要记下来，让事件循环线程把定时器提前，
+// 否则请求头、处理阶段的超时会被拖到空闲超时才生效
+void HttpConn::SetDeadline(int64_t deadline){
+    deadline_ms_.store(deadline);
+    if(deadline < armed_ms_.load()){
+        std::lock_guard<std::mutex> locker(shortened_mutex_);
+        shortened_.push_back(fd_);
+    }
+}
+
+// 事件循环线程按这个期限设置了定时器
+void HttpConn::SetArmed(int64_t armed_ms){
+    armed_ms_.store(armed_ms);
+}
+
+// 取出期限被提前的连接
+void HttpConn::TakeShortened(std::vector<int>* fds){
+    fds->clear();
+    std::lock_guard<std::mutex> locker(shortened_mutex_);
+    fds->swap(shortened_);
+}
+
+int64_t HttpConn::GetDeadline() const{
+    return deadline_ms_.load();
+}
+
+int HttpConn::GetPhase() const{
+    return phase_.load();
+}
+
+const char* HttpConn::PhaseName(int phase){
+    switch (phase) {
+        case PHASE_IDLE: return "idle";
+        case PHASE_HEADER: return "header";
+        case PHASE_BODY: return "body";
+        case PHASE_PROCESS: return "process";
+        case PHASE_WRITE: return "write";
+        default: return "unknown";
+    }
+}
+
+int64_t HttpConn::NowMs(){
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void HttpConn::SetSockCork(bool on){
+    int opt = on ? 1 : 0;
+    setsockopt(fd_, IPPROTO_TCP, TCP_CORK, &opt, sizeof(opt));
+    is_corked_ = on;
+}
+
 void HttpConn::SetSrcDir(const char* src_dir){
     src_dir_ = src_dir;
 }
@@ -153,6 +562,43 @@ void HttpConn::SetUserCount(const int user_count){
     user_count_ = user_count;
 }
 
-void HttpConn::SetIsEt(bool is_ET){
-    is_Et_ = is_ET;
-}
\ No newline at end of file
+// 各阶段的超时，0为不限制
+void HttpConn::SetTimeout(int header_ms, int body_ms, int idle_ms, int write_ms){
+    header_timeout_ms_ = header_ms;
+    body_timeout_ms_ = body_ms;
+    idle_timeout_ms_ = idle_ms;
+    write_timeout_ms_ = write_ms;
+}
+
+void HttpConn::SetMaxRequests(int max_requests){
+    max_requests_ = max_requests;
+}
+
+// 每次事件最多读写多少字节，0为不限制
+void HttpConn::SetIoBudget(std::size_t io_budget){
+    io_budget_ = io_budget;
+}
+
+// 请求头和请求体的最大字节数，0为不限制
+void HttpConn::SetRequestLimit(std::size_t max_header, std::size_t max_body){
+    max_header_bytes_ = max_header;
+    max_body_bytes_ = max_body;
+}
+
+uint64_t HttpConn::GetYieldCount(){
+    return yield_count_.load();
+}
+
+// 是否响应METRICS_PATH
+void HttpConn::SetMetrics(bool is_metrics){
+    is_metrics_ = is_metrics;
+}
+
+// 是否响应TRACE_PATH
+void HttpConn::SetTraceDump(bool is_trace_dump){
+    is_trace_dump_ = is_trace_dump;
+}
+
+void HttpConn::SetCork(bool is_cork){
+    is_cork_ = is_cork;
+}
@@ -4,12 +4,29 @@
 #include <arpa/inet.h>
 #include <atomic>
 #include <bits/types/struct_iovec.h>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
 #include <netinet/in.h>
 #include <sys/types.h>
+#include <vector>
 #include "../Buffer/buffer.h"
 #include "httprequest.h"
 #include "httpresponse.h"
 
+constexpr uint32_t CONN_OWNED = 1u << 31;         // 连接正被某个线程持有
+constexpr uint32_t CONN_CLOSE = 1u << 30;         // 要求持有连接的线程关闭连接
+constexpr std::size_t RECV_SIZE = 4096;           // io_uring完成模式每次recv至少留出的空间
+
+// 连接所处的阶段，每个阶段有自己的超时
+enum CONN_PHASE{
+    PHASE_IDLE = 0,         // 等待新请求
+    PHASE_HEADER = 1,       // 请求头收到一部分
+    PHASE_BODY = 2,         // 请求体收到一部分
+    PHASE_PROCESS = 3,      // 请求完整，正在处理，包括等待数据库
+    PHASE_WRITE = 4         // 响应没写完，等待可写
+};
+
 class HttpConn{
 public:
     HttpConn();
@@ -23,26 +40,88 @@ public:
     int ToWriteBytes();
     sockaddr_in GetAddr() const;
     bool process();
-    ssize_t read(int* save_errno);
+    bool IsPendingSql() const;
+    void ProcessSql();
+    bool IsClose() const;
+    bool CanInline();
+    bool HasRequest() const;
+    template<bool IS_ET>
+    ssize_t read(int* save_errno);          // ET要读到EAGAIN，LT读一次
+    template<bool IS_ET>
     ssize_t write(int* save_errno);
+    // io_uring完成模式：读写由调用者提交，完成后报告结果
+    char* RecvBuffer(std::size_t* len);
+    void Received(std::size_t len);
+    const struct iovec* WriteIov(int* cnt) const;
+    void Sent(std::size_t len);
     
+    bool Acquire(uint32_t events);
+    uint32_t TakeEvents();
+    bool Release();
+    void Requeue(uint32_t events);
+    uint32_t TakeYield();
+    void TraceQueued(int phase);
+    void TraceDequeued();
+
+    uint64_t GetTraceId() const {
+        return trace_id_;
+    }
+
     bool IsKeepAlive() const {
-        return request_.IsKeepAlive();
+        return keep_alive_;
     }
+
+    int64_t GetDeadline() const;
+    void SetArmed(int64_t armed_ms);
+    int GetPhase() const;
+    static const char* PhaseName(int phase);
     
     static void SetSrcDir(const char* src_dir);
     static void SetSrcDir(const std::string& src_dir);
     static void SetUserCount(const int user_count);
-    static void SetIsEt(bool is_ET);
+    static void SetCork(bool is_cork);
+    static void SetTimeout(int header_ms, int body_ms, int idle_ms, int write_ms);
+    static void SetMaxRequests(int max_requests);
+    static void SetIoBudget(std::size_t io_budget);
+    static void SetRequestLimit(std::size_t max_header, std::size_t max_body);
+    static void SetMetrics(bool is_metrics);
+    static void SetTraceDump(bool is_trace_dump);
+    static uint64_t GetYieldCount();
+    static int64_t NowMs();
+    static void TakeShortened(std::vector<int>* fds);
     static int GetUserCount() {return user_count_;}
 
 private:
+    void MakeResponse();
+    void SetSockCork(bool on);
+    void SetPhase(int phase, int timeout_ms);
+    void SetDeadline(int64_t deadline);
+    bool CheckRequest();
+    void NextKeepAlive();
+    void ReadDone(std::size_t readable, std::size_t total, int64_t trace_us);
+    void Advance(std::size_t len);
+    void WriteDone(std::size_t total, int64_t trace_us);
 
 private:
     int fd_;
     struct sockaddr_in addr_;
 
     bool is_close_;
+    bool is_corked_;            // 当前响应是否加了TCP_CORK
+    std::atomic<uint32_t> owner_state_;         // CONN_OWNED | 持有期间到达的事件
+    std::atomic<int64_t> deadline_ms_;          // 当前阶段的截止时间，定时器到期时据此判断是否真的超时
+    std::atomic<int64_t> armed_ms_;             // 定时器里这个连接的到期时间，由事件循环线程设置
+    std::atomic_int phase_;
+    int reject_code_;                   // 请求超过上限时回应的状态码，0为正常请求
+    int request_count_;                 // 这条连接已经处理的请求数
+    bool keep_alive_;                   // 当前响应之后是否保持连接
+    uint32_t yield_events_;             // 读写用完预算让出时还没处理完的方向，EPOLLIN/EPOLLOUT
+    int64_t request_start_us_;          // 当前请求收到第一个字节的时间，0为没有正在处理的请求
+    uint64_t trace_id_;                 // 当前请求的追踪id，请求写完后换下一个
+    int64_t queued_us_;                 // 交给线程池或者数据库线程的时间，0为不在队列中
+    int queued_phase_;                  // 在哪个队列中等待，TP_QUEUE或者TP_SQL_QUEUE
+    std::size_t response_bytes_;        // 当前响应的总长度，写完后清零
+    uint64_t capture_id_;               // 抓包时的连接号，0为不抓包
     int iov_cnt_;
     struct iovec iov_[2];
 
@@ -52,7 +131,20 @@ private:
     HttpRequest request_;           
     HttpResponse response_;
 
-    static bool is_Et_;
+    static bool is_cork_;
+    static bool is_metrics_;
+    static bool is_trace_dump_;
+    static int header_timeout_ms_;
+    static int body_timeout_ms_;
+    static int idle_timeout_ms_;
+    static int write_timeout_ms_;
+    static int max_requests_;
+    static std::size_t io_budget_;
+    static std::size_t max_header_bytes_;
+    static std::size_t max_body_bytes_;
+    static std::atomic<uint64_t> yield_count_;
+    static std::mutex shortened_mutex_;
+    static std::vector<int> shortened_;        // 期限被提前到定时器之前的连接，等事件循环线程调整定时器
     static const char* src_dir_;
     static std::atomic_int user_count_;
 };
@@ -2,7 +2,9 @@
 #include <algorithm>
 #include <cassert>
 #include <cstdio>
+#include <cstdlib>
 #include <cstring>
+#include <functional>
 #include <regex>
 #include <string>
 #include <strings.h>
@@ -12,12 +14,21 @@
 #include "../Log/log.h"
 #include "mysql.h"
 #include "../Pool/sqlconnpool.h"
+#include "../Pool/registerbuffer.h"
+#include "../Pool/singleflight.h"
+#include "../Pool/userfilter.h"
+#include "sessionstore.h"
 
 const std::unordered_set<std::string> HttpRequest::DEFAULT_HTML {
     "/index","/register","/login","/welcome","/vedio",
     "/picture"
 };
 
+// 需要登录才能访问的页面，开启会话后没有有效cookie会被转到登录页
+const std::unordered_set<std::string> HttpRequest::PROTECTED_HTML {
+    "/welcome.html"
+};
+
 const std::unordered_map<std::string, int> DEFUALT_HTML_TAG{
     {"/register.html",0}, {"/login.html",1}
 };
@@ -25,12 +36,15 @@ const std::unordered_map<std::string, int> DEFUALT_HTML_TAG{
 
 HttpRequest::HttpRequest() :
     state_(REQUEST_LINE),
+    verify_tag_(-1),
+    content_length_(0),
     method_(""),
     path_(""),
     version_(""),
     body_(""),
     header_(),
-    post_()
+    post_(),
+    cookie_()
 {
 
 }
@@ -38,8 +52,13 @@ HttpRequest::HttpRequest() :
 void HttpRequest::Init(){
     method_ = path_ = version_ = body_ = "";
     state_ = REQUEST_LINE;
+    verify_tag_ = -1;
+    content_length_ = 0;
     header_.clear();
     post_.clear();
+    cookie_.clear();
+    session_user_.clear();
+    new_session_.clear();
 }
 
 bool HttpRequest::Parse(Buffer& buff){
@@ -48,6 +67,16 @@ bool HttpRequest::Parse(Buffer& buff){
         return false;
     }
 
+    // 请求体长度直接从原始请求头取，和CheckComplete判断收完整时用的是同一个值
+    const char END[] = "\r\n\r\n";
+    const char* header_end = std::search(buff.Peek(), buff.BeginWriteConst(), END, END + 4);
+    long body_len = header_end == buff.BeginWriteConst() ? 0 : ParseContentLength(buff.Peek(), header_end);
+    if(body_len < 0){
+        LOG_ERROR("Content-length Parse Error!");
+        return false;
+    }
+    content_length_ = body_len;
+
     while(buff.ReadableBytes() && state_ != FINISH){
         // 从读空间到写空间找行结束标志
         const char* line_end = std::search(buff.Peek(), buff.BeginWriteConst(), CRLF, CRLF + 2);
@@ -63,12 +92,16 @@ bool HttpRequest::Parse(Buffer& buff){
             case HEADERS:
                 ParseHeader(line);
 
-                if(buff.ReadableBytes() <= 2)       // 如果处理请求体过程中发现剩余待处理内容长度小于2(结束符)，则说明不是post方式
+                if(state_ == BODY && ContentLength() == 0)      // 空行之后没有请求体，后面的字节属于流水线上的下一个请求
                     state_ = FINISH;
                 break;
-            case BODY:
-                ParseBody(line);
-                break;
+            case BODY:{
+                // 请求体按Content-length截取，CheckComplete已经保证收完整
+                std::size_t len = std::min(content_length_, buff.ReadableBytes());
+                ParseBody(std::string(buff.Peek(), len));
+                buff.Retrieve(len);
+                continue;
+            }
             case FINISH:
                 break;
             default:
@@ -78,6 +111,7 @@ bool HttpRequest::Parse(Buffer& buff){
         buff.RetrieveUntil(line_end + 2);           // 不是很理解这个有什么用
     }
 
+    ParseSession();
     LOG_DEBUG("[%s], [%s], [%s]", method_.c_str(), path_.c_str(), version_.c_str());
     return true;
 }
@@ -105,13 +139,119 @@ bool HttpRequest::ParseRequestLine(const std::string& str){
 }
 
 void HttpRequest::ParsePath(){
-    if(path_ == "/"){
-        path_ = "/index.html";
+    path_ = MapPath(path_);
+}
+
+// 请求路径对应的文件路径
+std::string HttpRequest::MapPath(const std::string& path){
+    if(path == "/"){
+        return "/index.html";
     }else{
-        if(DEFAULT_HTML.count(path_) == 1){
-                path_ += ".html";
+        if(DEFAULT_HTML.count(path) == 1){
+                return path + ".html";
+        }
+    }
+    return path;
+}
+
+// 检查请求是否收完整：请求头以空行结束，有Content-length的还要收够请求体。
+// 请求头(含空行)超过max_header、Content-length超过max_body时不再等待，由调用者拒绝，0为不限制
+HttpRequest::RECV_STATE HttpRequest::CheckComplete(const Buffer& buff, std::size_t max_header, std::size_t max_body){
+    const char END[] = "\r\n\r\n";
+    const char* begin = buff.Peek();
+    const char* end = buff.BeginWriteConst();
+    const char* header_end = std::search(begin, end, END, END + 4);
+    if(header_end == end)
+        return max_header > 0 && buff.ReadableBytes() > max_header ? RECV_BAD : RECV_HEADER;
+    if(max_header > 0 && (std::size_t)(header_end + 4 - begin) > max_header)
+        return RECV_BAD;
+
+    long body_len = ParseContentLength(begin, header_end);
+    if(body_len < 0)
+        return RECV_BAD;
+    if(max_body > 0 && body_len > 0 && (std::size_t)body_len > max_body)
+        return RECV_TOO_LARGE;
+    if(body_len > end - (header_end + 4))
+        return RECV_BODY;
+    return RECV_COMPLETE;
+}
+
+// 从原始请求头[begin, header_end)中取Content-length，没有为0。值不是十进制数字(包括负数)、太大，
+// 或者多个Content-length的值不一致时返回-1，这时无法确定请求在哪里结束，只能拒绝
+long HttpRequest::ParseContentLength(const char* begin, const char* header_end){
+    const char END[] = "\r\n";
+    const char KEY[] = "content-length:";
+    const size_t KEY_LEN = sizeof(KEY) - 1;
+    const long MAX_LEN = 1L << 40;
+    long body_len = -1;
+    for(const char* line = begin; line < header_end;){
+        const char* line_end = std::search(line, header_end, END, END + 2);
+        if((size_t)(line_end - line) >= KEY_LEN && strncasecmp(line, KEY, KEY_LEN) == 0){
+            const char* p = line + KEY_LEN;
+            const char* q = line_end;
+            while(p < q && (*p == ' ' || *p == '\t'))
+                p++;
+            while(q > p && (q[-1] == ' ' || q[-1] == '\t'))
+                q--;
+            if(p == q)
+                return -1;
+            long len = 0;
+            for(; p < q; p++){
+                if(*p < '0' || *p > '9' || len > MAX_LEN)
+                    return -1;
+                len = len * 10 + (*p - '0');
+            }
+            if(body_len >= 0 && body_len != len)
+                return -1;
+            body_len = len;
+        }
+        line = line_end + 2;
+    }
+    return body_len < 0 ? 0 : body_len;
+}
+
+// 不解析整个报文，只看缓冲区里是不是恰好一个完整、没有请求体的GET，并得到要访问的文件路径。
+// 需要登录的页面要查会话，这里不处理
+bool HttpRequest::PeekStaticPath(const Buffer& buff, std::string* path, bool* accept_gzip){
+    const char END[] = "\r\n\r\n";
+    const char* begin = buff.Peek();
+    const char* end = buff.BeginWriteConst();
+    const char* header_end = std::search(begin, end, END, END + 4);
+    if(header_end == end || header_end + 4 != end)      // 报文不完整，或者后面还有请求体、下一个请求
+        return false;
+
+    if(end - begin < 4 || memcmp(begin, "GET ", 4) != 0)
+        return false;
+
+    const char* line_end = std::search(begin, end, END, END + 2);
+    const char* path_begin = begin + 4;
+    const char* path_end = std::find(path_begin, line_end, ' ');
+    const char VERSION[] = " HTTP/";
+    if(path_end == line_end || std::search(path_end, line_end, VERSION, VERSION + 6) != path_end)
+        return false;
+
+    std::string file = MapPath(std::string(path_begin, path_end));
+    if(PROTECTED_HTML.count(file))
+        return false;
+
+    // 响应要不要压缩取决于Accept-Encoding，调用者据此判断压缩版本是否已经缓存
+    *accept_gzip = false;
+    const char HEADER[] = "Accept-Encoding:";
+    const std::size_t header_len = sizeof(HEADER) - 1;
+    for(const char* line = line_end + 2; line < header_end; ){
+        const char* next = std::search(line, header_end, END, END + 2);
+        if((std::size_t)(next - line) >= header_len && strncasecmp(line, HEADER, header_len) == 0){
+            const char* value = line + header_len;
+            while(value < next && *value == ' ')
+                value++;
+            *accept_gzip = HasGzip(std::string(value, next));
+            break;
         }
+        line = next + 2;
     }
+
+    *path = file;
+    return true;
 }
 
 void HttpRequest::ParseHeader(const std::string& str){
@@ -124,6 +264,19 @@ void HttpRequest::ParseHeader(const std::string& str){
     }
 }
 
+// 请求头的名字不区分大小写，找不到返回nullptr
+const std::string* HttpRequest::FindHeader(const char* key) const {
+    for(auto& item : header_){
+        if(strcasecmp(item.first.c_str(), key) == 0)
+            return &item.second;
+    }
+    return nullptr;
+}
+
+std::size_t HttpRequest::ContentLength() const {
+    return content_length_;
+}
+
 void HttpRequest::ParseBody(const std::string& str){
     body_ = str;
     ParsePost();        // 处理请求体，转到处理Post请求
@@ -131,6 +284,58 @@ void HttpRequest::ParseBody(const std::string& str){
     LOG_DEBUG("Body:%s, len:%d", str.c_str(), str.size());
 }
 
+// 解析Cookie请求头，格式为 a=1; b=2
+void HttpRequest::ParseCookie(){
+    const std::string* value = FindHeader("Cookie");
+    if(!value)
+        return;
+
+    const std::string& str = *value;
+    std::string::size_type i = 0;
+    while(i < str.size()){
+        std::string::size_type end = str.find(';', i);
+        if(end == std::string::npos)
+            end = str.size();
+
+        std::string::size_type eq = str.find('=', i);
+        if(eq != std::string::npos && eq < end){
+            std::string::size_type key_begin = str.find_first_not_of(' ', i);
+            cookie_[str.substr(key_begin, eq - key_begin)] = str.substr(eq + 1, end - eq - 1);
+        }
+        i = end + 1;
+    }
+}
+
+// 通过cookie中的会话id认证用户，不用再查数据库
+void HttpRequest::ParseSession(){
+    if(!SessionStore::Instance().IsOpen())
+        return;
+
+    ParseCookie();
+    SessionStore::Instance().Get(GetCookie("sid"), &session_user_);
+
+    // 已经登录的用户再次提交登录，直接进入欢迎页
+    if(verify_tag_ == 1 && !session_user_.empty() && session_user_ == post_["username"]){
+        verify_tag_ = -1;
+        path_ = "/welcome.html";
+    }
+
+    if(session_user_.empty() && !IsPendingVerify() && PROTECTED_HTML.count(path_)){
+        path_ = "/login.html";
+    }
+}
+
+std::string HttpRequest::GetCookie(const std::string& key) const{
+    auto it = cookie_.find(key);
+    if(it == cookie_.end())
+        return "";
+    return it->second;
+}
+
+std::string HttpRequest::NewSession() const{
+    return new_session_;
+}
+
 bool HttpRequest::IsKeepAlive() const {
     if(header_.count("Connection") == 1){
         return header_.find("Connection")->second == "keep-alive" && version_ == "1.1";
@@ -139,6 +344,35 @@ bool HttpRequest::IsKeepAlive() const {
     return false;
 }
 
+bool HttpRequest::AcceptsGzip() const {
+    const std::string* value = FindHeader("Accept-Encoding");
+    return value && HasGzip(*value);
+}
+
+// Accept-Encoding中有gzip或者*，并且q不为0，例如"gzip, deflate, br"、"gzip;q=0.8"
+bool HttpRequest::HasGzip(const std::string& accept_encoding){
+    std::string::size_type i = 0;
+    while(i < accept_encoding.size()){
+        std::string::size_type end = accept_encoding.find(',', i);
+        if(end == std::string::npos)
+            end = accept_encoding.size();
+        std::string item = accept_encoding.substr(i, end - i);
+        i = end + 1;
+
+        std::string::size_type semi = item.find(';');
+        std::string coding = item.substr(0, semi);
+        coding.erase(0, coding.find_first_not_of(' '));
+        coding.erase(coding.find_last_not_of(' ') + 1);
+        if(strcasecmp(coding.c_str(), "gzip") != 0 && coding != "*")
+            continue;
+        if(semi == std::string::npos)
+            return true;
+        std::string::size_type q = item.find("q=", semi);
+        return q == std::string::npos || strtod(item.c_str() + q + 2, nullptr) > 0;
+    }
+    return false;
+}
+
 // 解析URL编码
 void HttpRequest::ParseFromUrlencoded(){
     if(body_.size() == 0) return;
@@ -190,91 +424,154 @@ void HttpRequest::ParsePost(){
             int tag = DEFUALT_HTML_TAG.find(path_)->second;     
             LOG_DEBUG("Tag:%d", tag);
             if(tag == 0 || tag == 1){
-                bool is_login = (tag == 1);         // 如果是登录
-                if(UserVerify(post_["username"], post_["password"], is_login)) {
-                    path_ = "/welcome.html";
-                } 
-                else {
-                    path_ = "/error.html";
-                }
+                verify_tag_ = tag;          // 不在这里查询数据库，挂起请求，交给数据库线程调用Verify
             }
         }
     }
 }
 
+bool HttpRequest::IsPendingVerify() const {
+    return verify_tag_ != -1;
+}
+
+// 在数据库线程中执行，完成校验后根据结果改写请求路径
+void HttpRequest::Verify(){
+    assert(IsPendingVerify());
+    bool is_login = (verify_tag_ == 1);         // 如果是登录
+    if(UserVerify(post_["username"], post_["password"], is_login)) {
+        path_ = "/welcome.html";
+        if(is_login && SessionStore::Instance().IsOpen()){          // 登录成功，创建会话，之后的请求凭cookie认证
+            new_session_ = SessionStore::Instance().Create(post_["username"]);
+        }
+    } 
+    else {
+        path_ = "/error.html";
+    }
+    verify_tag_ = -1;
+}
+
+// 同一个用户名的并发查询只发一次SELECT，其余请求共享结果，重试风暴时不会占满连接池
+static SingleFlight<std::string, HttpRequest::UserRow> user_flight;
+
+// 因为合并查询而省掉的SELECT次数
+uint64_t HttpRequest::GetCoalescedCount(){
+    return user_flight.GetSharedCount();
+}
+
 bool HttpRequest::UserVerify(const std::string& name, const std::string&pwd, bool is_login){
     if(name.size() == 0 || pwd.size() == 0) return false;
 
     LOG_INFO("Verify name:%s pwd:%s", name.c_str(), pwd.c_str());
-    MYSQL* sql;
-    sql = SqlConnPool::Instance().GetConn();
-    if(sql == nullptr)
+
+    // 还在写回缓冲中没有落库的用户，直接在内存中校验
+    std::string buffered_pwd;
+    if(RegisterBuffer::Instance().IsOpen() && RegisterBuffer::Instance().Find(name, &buffered_pwd)){
+        if(is_login)
+            return pwd == buffered_pwd;
+
+        LOG_ERROR("%s", "User Register, but user used");
         return false;
+    }
+
+    // 布隆过滤器判定不存在的用户名一定没有注册过，不用查数据库
+    UserRow row;
+    bool may_exist = UserFilter::Instance().MayExist(name);
+    if(may_exist){
+        row = user_flight.Do(name, std::bind(&HttpRequest::QueryUser, name));
+    }else{
+        row.ok = true;
+    }
+
+    if(!row.ok)             // 如果sql执行失败
+        return false;
+    if(may_exist && !row.found)
+        UserFilter::Instance().ReportFalsePositive();
+
+    if(is_login){           // 如果是登录
+        if(row.found && pwd == row.password)
+            return true;
+
+        LOG_ERROR("%s", "password error!");
+        return false;
+    }
+
+    if(row.found){          // 在注册流程中，如果有返回值，就说明这个用户已经被注册了
+        LOG_ERROR("%s", "User Register, but user used");
+        return false;
+    }
 
+    // 正常情况下的注册行为，用户名没有被使用
     bool flag = false;
-    unsigned int j = 0;
-    char order[256];
-    bzero(order, 256);
-    MYSQL_FIELD *fields = nullptr;
-    MYSQL_RES *res = nullptr;
+    if(RegisterBuffer::Instance().IsOpen()){
+        flag = RegisterBuffer::Instance().Add(name, pwd);       // 先写入内存表，由后台线程批量落库
+    }else{
+        flag = InsertUser(name, pwd);
+    }
+
+    if(flag)
+        UserFilter::Instance().Add(name);
+    return flag;
+}
 
-    if(!is_login)   flag = true;            // 如果是注册用户
+HttpRequest::UserRow HttpRequest::QueryUser(const std::string& name){
+    UserRow row;
+    MYSQL* sql = SqlConnPool::Instance().GetConn();
+    if(sql == nullptr)
+        return row;
 
+    char order[256];
+    bzero(order, 256);
     snprintf(order, 256, "SELECT username, password FROM user WHERE username='%s' LIMIT 1", name.c_str());
     LOG_DEBUG("%s", order);
 
-    if(mysql_query(sql, order)){        // 如果sql执行失败
-        mysql_free_result(res);
-        return false;
+    if(mysql_query(sql, order)){        // 如果sql执行失败，连接要还回连接池
+        SqlConnPool::Instance().FreeConn(sql);
+        return row;
     }
 
-    res = mysql_store_result(sql);
-    j = mysql_num_fields(res);
-    fields = mysql_fetch_fields(res);
+    row.ok = true;
+    MYSQL_RES* res = mysql_store_result(sql);
+    if(MYSQL_ROW mysql_row = mysql_fetch_row(res)){            // 如果有返回值
+        LOG_DEBUG("MYSQL ROW: %s %s", mysql_row[0], mysql_row[1]);
+        row.found = true;
+        row.password = mysql_row[1];
+    }
+    mysql_free_result(res);
 
-    while(MYSQL_ROW row = mysql_fetch_row(res)){            // 如果有返回值
-        LOG_DEBUG("MYSQL ROW: %s %s", row[0], row[1]);
-        std::string password(row[1]);
+    SqlConnPool::Instance().FreeConn(sql);
+    LOG_DEBUG("%s", "End QueryUser");
+    return row;
+}
 
-        if(is_login){           // 如果是登录
-            if(pwd == password)             
-                flag = true;
-            else{
-                flag = false;
-                LOG_ERROR("%s", "password error!");
-            }
-        }else{
-            flag = false;               // 在注册流程中，如果有返回值，就说明这个用户已经被注册了
-            LOG_ERROR("%s", "User Register, but user used");
-        }
+bool HttpRequest::InsertUser(const std::string& name, const std::string& pwd){
+    MYSQL* sql = SqlConnPool::Instance().GetConn();
+    if(sql == nullptr)
+        return false;
 
-        mysql_free_result(res);
-    }
+    LOG_DEBUG("%s", "User Register");
+    char order[256];
+    bzero(order, 256);
+    snprintf(order, 256, "INSERT INTO user(username, password) VALUES('%s','%s')", name.c_str(), pwd.c_str());
+    LOG_DEBUG("%s", order);
 
-    // 正常情况下的注册行为，用户名没有被使用
-    if(!is_login && flag == true){
-        LOG_DEBUG("%s", "User Register");
-        bzero(order, 256);
-        snprintf(order, 256, "INSERT INTO user(username, password) VALUES('%s','%s')", name.c_str(), pwd.c_str());
-        LOG_DEBUG("%s", order);
-        
-        if(mysql_query(sql, order)){
-            LOG_ERROR("%s", "User Register Error, Unknown Error!");
-            flag = false;
-        }else{
-            flag = true;
-        }
+    bool flag = true;
+    if(mysql_query(sql, order)){
+        LOG_ERROR("%s", "User Register Error, Unknown Error!");
+        flag = false;
     }
 
     SqlConnPool::Instance().FreeConn(sql);
-    LOG_DEBUG("%s", "End UserVerify");
     return flag;
 }
 
-std::string HttpRequest::path() const {
+const std::string& HttpRequest::path() const {
     return path_;
 }
 
+const std::string& HttpRequest::method() const {
+    return method_;
+}
+
 std::string HttpRequest::GetPost(const std::string& key) const{
     assert(key.size());
     if(post_.count(key) == 1){
@@ -1,5 +1,6 @@
 #ifndef HTTPREQUEST_H
 #define HTTPREQUEST_H
+#include <cstdint>
 #include <string>
 #include <unordered_map>
 #include <unordered_set>
@@ -7,6 +8,15 @@
 
 class HttpRequest{
 public:
+    // 缓冲区里的请求收到了哪一步
+    enum RECV_STATE{
+        RECV_COMPLETE=0,
+        RECV_HEADER=1,          // 请求头还没收完
+        RECV_BODY=2,            // 请求头收完了，请求体还没收完
+        RECV_BAD=3,             // 请求头超过上限，或者Content-length不合法
+        RECV_TOO_LARGE=4        // 请求体超过上限
+    };
+
     enum PARSE_STATE{
         REQUEST_LINE=0,
         HEADERS=1,
@@ -14,6 +24,13 @@ public:
         FINISH=3
     };
 
+    // 用户表中查询到的一行
+    struct UserRow{
+        bool ok = false;            // sql是否执行成功
+        bool found = false;
+        std::string password;
+    };
+
     HttpRequest();
     ~HttpRequest() = default;
 
@@ -21,34 +38,58 @@ public:
 
     bool Parse(Buffer& buff);
     bool IsKeepAlive() const;
+    bool AcceptsGzip() const;
+    bool IsPendingVerify() const;
+    void Verify();
+    std::string GetCookie(const std::string& key) const;
+    std::string NewSession() const;
 
-    std::string path() const;
-    std::string method() const;
+    const std::string& path() const;
+    const std::string& method() const;
     std::string version() const;
     std::string GetPost(const std::string& key) const;
     std::string GetPost(const char* key) const;
 
+    static uint64_t GetCoalescedCount();
+    static bool PeekStaticPath(const Buffer& buff, std::string* path, bool* accept_gzip);
+    static RECV_STATE CheckComplete(const Buffer& buff, std::size_t max_header, std::size_t max_body);
+
 private:
     static int ConverHex2Dec(char ch);
+    static bool HasGzip(const std::string& accept_encoding);
+    static long ParseContentLength(const char* begin, const char* header_end);
 
     bool ParseRequestLine(const std::string& str);
     void ParseHeader(const std::string& str);
     void ParseBody(const std::string& str);
+    std::size_t ContentLength() const;
+    const std::string* FindHeader(const char* key) const;
 
     void ParsePath();
+    static std::string MapPath(const std::string& path);
+    void ParseCookie();
+    void ParseSession();
     void ParsePost();
     void ParseFromUrlencoded();
     bool UserVerify(const std::string& name, const std::string&pwd, bool is_login);
+    static UserRow QueryUser(const std::string& name);
+    static bool InsertUser(const std::string& name, const std::string& pwd);
 
 
 private:
     PARSE_STATE state_;
+    int verify_tag_;            // 挂起的数据库校验：-1 没有，0 注册，1 登录
+    std::size_t content_length_;    // 请求体长度，和CheckComplete用同一个函数解析
     std::string method_, path_, version_, body_;
     std::unordered_map<std::string, std::string> header_;
     std::unordered_map<std::string, std::string> post_;
+    std::unordered_map<std::string, std::string> cookie_;
+    std::string session_user_;          // 通过cookie认证的用户
+    std::string new_session_;           // 本次登录成功新建的会话id
 
 
     static const std::unordered_set<std::string> DEFAULT_HTML;
+    static const std::unordered_set<std::string> PROTECTED_HTML;
     static const std::unordered_map<std::string, int> DEFAULT_HTML_TAG;
 
 };
@@ -6,6 +6,7 @@
 #include <sys/mman.h>
 #include <fcntl.h>
 #include "../Log/log.h"
+#include "../Metrics/metrics.h"
 
 const std::unordered_map<std::string, std::string> HttpResponse::SUFFIX_TYPE = {
     { ".html",  "text/html" },
@@ -25,8 +26,15 @@ const std::unordered_map<std::string, std::string> HttpResponse::SUFFIX_TYPE = {
     { ".avi",   "video/x-msvideo" },
     { ".gz",    "application/x-gzip" },
     { ".tar",   "application/x-tar" },
-    { ".css",   "text/css "},
-    { ".js",    "text/javascript "},
+    { ".css",   "text/css" },
+    { ".js",    "text/javascript" },
+    { ".svg",   "image/svg+xml" },
+};
+
+// 文本类型压缩效果好，图片、视频和压缩包本身已经压缩过
+const std::unordered_set<std::string> HttpResponse::GZIP_TYPE = {
+    "text/html", "text/xml", "application/xhtml+xml", "text/plain", "application/rtf",
+    "text/css", "text/javascript", "image/svg+xml",
 };
 
 const std::unordered_map<int, std::string> HttpResponse::CODE_STATUS = {
@@ -34,6 +42,7 @@ const std::unordered_map<int, std::string> HttpResponse::CODE_STATUS = {
     { 400, "Bad Request" },
     { 403, "Forbidden" },
     { 404, "Not Found" },
+    { 413, "Payload Too Large" },
 };
 
 const std::unordered_map<int, std::string> HttpResponse::CODE_PATH = {
@@ -46,8 +55,15 @@ HttpResponse::HttpResponse() :
     code_(-1),
     path_(""),
     src_dir_(""),
+    cookie_(""),
+    keep_alive_max_(0),
+    keep_alive_timeout_s_(0),
     mm_file_(nullptr),
-    mm_file_stat_({0})
+    mm_file_stat_({0}),
+    has_body_(false),
+    accept_gzip_(false),
+    is_gzip_(false),
+    vary_(false)
 {
     
 }
@@ -61,6 +77,8 @@ int HttpResponse::GetCode() const {
 }
 
 char* HttpResponse::GetFile(){
+    if(cached_file_)
+        return const_cast<char*>(cached_file_->data.data());
     return mm_file_;
 }
 
@@ -74,6 +92,7 @@ void HttpResponse::UnmapFile(){
         munmap(mm_file_, mm_file_stat_.st_size);
         mm_file_ = nullptr;
     }
+    cached_file_.reset();
 }
 
 void HttpResponse::Init(const std::string& src_dir, const std::string& path, bool is_keep_alive, int code){
@@ -83,17 +102,56 @@ void HttpResponse::Init(const std::string& src_dir, const std::string& path, boo
     path_ = path;
     is_keep_alive_ = is_keep_alive;
     code_ = code;
+    cookie_.clear();
+    keep_alive_max_ = 0;
+    keep_alive_timeout_s_ = 0;
     mm_file_stat_ = {0};
+    has_body_ = false;
+    body_.clear();
+    accept_gzip_ = false;
+    is_gzip_ = false;
+    vary_ = false;
+}
+
+void HttpResponse::SetKeepAlive(int max, int timeout_s){
+    keep_alive_max_ = max;
+    keep_alive_timeout_s_ = timeout_s;
+}
+
+// 使用生成的内容作为响应，类型仍然按路径后缀判断
+void HttpResponse::SetBody(std::string body){
+    body_ = std::move(body);
+    has_body_ = true;
+}
+
+void HttpResponse::SetAcceptGzip(bool accept_gzip){
+    accept_gzip_ = accept_gzip;
+}
+
+void HttpResponse::SetCookie(const std::string& key, const std::string& value, int max_age_s){
+    cookie_ = key + "=" + value + "; Path=/; Max-Age=" + std::to_string(max_age_s) + "; HttpOnly";
 }
 
 // 判断是不是http错误码响应
 void HttpResponse::ErrorHtml(){
     if(CODE_PATH.count(code_) == 1){
         path_ = CODE_PATH.find(code_)->second;
-        stat((src_dir_ + path_).c_str(), &mm_file_stat_);
+        StatFile();
     }
 }
 
+// 获取文件信息，开启了文件缓存就顺便把文件读进缓存，之后AddContent不用再打开文件
+int HttpResponse::StatFile(){
+    if(FileCache::Instance().IsOpen()){
+        cached_file_ = FileCache::Instance().Get(src_dir_ + path_);
+        if(cached_file_){
+            mm_file_stat_ = cached_file_->st;
+            return 0;
+        }
+    }
+    return stat((src_dir_ + path_).c_str(), &mm_file_stat_);
+}
+
 void HttpResponse::AddStateLine(Buffer& buff){
     std::string status;
     if(CODE_STATUS.count(code_) == 1){
@@ -106,23 +164,42 @@ void HttpResponse::AddStateLine(Buffer& buff){
 }
 
 void HttpResponse::AddHeader(Buffer& buff){
-    buff.Append("Connecton: ");
+    buff.Append("Connection: ");
     if(is_keep_alive_){
         buff.Append("keep-alive\r\n");
-        buff.Append("keep-alive: max=6, timeout=120\r\n");
+        if(keep_alive_timeout_s_ > 0){          // 告诉客户端服务器实际执行的空闲超时和剩余请求数
+            buff.Append("Keep-Alive: timeout=" + std::to_string(keep_alive_timeout_s_));
+            if(keep_alive_max_ > 0){
+                buff.Append(", max=" + std::to_string(keep_alive_max_));
+            }
+            buff.Append("\r\n");
+        }
     }else{
         buff.Append("close\r\n");
     }
     buff.Append("Content-type: " + GetFileType() + "\r\n");
+    if(vary_){
+        buff.Append("Vary: Accept-Encoding\r\n");
+    }
+    if(is_gzip_){
+        buff.Append("Content-Encoding: gzip\r\n");
+    }
+    if(!cookie_.empty()){
+        buff.Append("Set-Cookie: " + cookie_ + "\r\n");
+    }
 }
 
 std::string HttpResponse::GetFileType(){
-    std::string::size_type index = path_.find_last_of('.');     // 返回最后一个.的位置
+    return FileType(path_);
+}
+
+std::string HttpResponse::FileType(const std::string& path){
+    std::string::size_type index = path.find_last_of('.');     // 返回最后一个.的位置
     if(index == std::string::npos){
         return "text/plain";            // 如果找不到，就是"text/plain"类型
     }
 
-    std::string suffix = path_.substr(index);       // 能找到，就通过文件后缀查找文件类型
+    std::string suffix = path.substr(index);       // 能找到，就通过文件后缀查找文件类型
     if(SUFFIX_TYPE.count(suffix) == 1){
         return SUFFIX_TYPE.find(suffix)->second;
     }
@@ -152,13 +229,18 @@ void HttpResponse::ErrorContent(Buffer& buff,const std::string& message){
 }
 
 void HttpResponse::AddContent(Buffer& buff){
-    int src_fd = open((src_dir_ + path_).c_str(), O_RDONLY);        // 如果打开资源文件失败
+    if(cached_file_){
+        buff.Append("Content-length: " + std::to_string(mm_file_stat_.st_size) + "\r\n\r\n");
+        return;
+    }
+
+    int src_fd = open(FilePath().c_str(), O_RDONLY);        // 如果打开资源文件失败
     if(src_fd < 0){
         ErrorContent(buff, "File NotFound");
         return;
     }
 
-    LOG_DEBUG("file path %s ", (src_dir_ + path_).c_str());
+    LOG_DEBUG("file path %s ", FilePath().c_str());
     int* mm_ret = (int*)mmap(0, mm_file_stat_.st_size, PROT_READ, MAP_PRIVATE, src_fd, 0);
 
     if(*mm_ret == -1){      // 如果建立文件内存映射失败
@@ -173,9 +255,58 @@ void HttpResponse::AddContent(Buffer& buff){
 }
 
 
+// 实际发送的文件，发送gzip版本并且没有缓存时是磁盘上的.gz
+std::string HttpResponse::FilePath() const {
+    return src_dir_ + path_ + (is_gzip_ ? ".gz" : "");
+}
+
+// 可压缩的类型都发送Vary，不管这次是否压缩，避免中间缓存把压缩版本发给不支持的客户端。
+// 开启文件缓存时从缓存取gzip版本(.gz或者压缩一次的结果)，否则只用磁盘上不比原文件旧的.gz
+void HttpResponse::NegotiateEncoding(){
+    if(!IsCompressible(path_, mm_file_stat_.st_size))
+        return;
+    vary_ = true;
+    if(!accept_gzip_)
+        return;
+
+    std::size_t original = mm_file_stat_.st_size;
+    if(FileCache::Instance().IsOpen()){
+        std::shared_ptr<const CachedFile> gz = FileCache::Instance().GetGzip(src_dir_ + path_, mm_file_stat_);
+        if(!gz)
+            return;
+        cached_file_ = gz;
+        mm_file_stat_.st_size = gz->data.size();
+    }else{
+        struct stat st;
+        std::string file = src_dir_ + path_ + ".gz";
+        if(stat(file.c_str(), &st) < 0 || !S_ISREG(st.st_mode) || !(st.st_mode & S_IROTH) || st.st_mtime < mm_file_stat_.st_mtime)
+            return;
+        mm_file_stat_ = st;
+    }
+    is_gzip_ = true;
+    Metrics::Add(MC_GZIP);
+    Metrics::Add(MC_GZIP_ORIGINAL_BYTES, original);
+    Metrics::Add(MC_GZIP_BYTES, mm_file_stat_.st_size);
+}
+
+// 这个文件是否值得发送gzip版本
+bool HttpResponse::IsCompressible(const std::string& path, std::size_t size){
+    return size >= GZIP_MIN_SIZE && GZIP_TYPE.count(FileType(path)) == 1;
+}
+
 // 生成响应报文
 void HttpResponse::MakeResponse(Buffer& buff){
-    if(stat((src_dir_ + path_).c_str(), &mm_file_stat_) < 0 && S_ISDIR(mm_file_stat_.st_mode)){     // 先看看这个文件存不存在，再看看是不是文件夹
+    if(has_body_){
+        if(code_ == -1)
+            code_ = 200;
+        AddStateLine(buff);
+        AddHeader(buff);
+        buff.Append("Content-length: " + std::to_string(body_.size()) + "\r\n\r\n");
+        buff.Append(body_);
+        return;
+    }
+
+    if(StatFile() < 0 && S_ISDIR(mm_file_stat_.st_mode)){     // 先看看这个文件存不存在，再看看是不是文件夹
         code_ = 404;
     }else if(!(mm_file_stat_.st_mode & S_IROTH)){           // 如果对访问的资源的权限不足
         code_ = 403;
@@ -184,6 +315,9 @@ void HttpResponse::MakeResponse(Buffer& buff){
     }
 
     ErrorHtml();                // 如果返回的是错误码，则会在这个函数中打开错误码对应的html
+    if(code_ == 200){
+        NegotiateEncoding();
+    }
     AddStateLine(buff);         
     AddHeader(buff);
     AddContent(buff);
@@ -2,11 +2,15 @@
 #define HTTPRESPONSE_H
 
 #include <cstddef>
+#include <memory>
 #include <string>
 #include <sys/stat.h>
 #include <unordered_map>
+#include <unordered_set>
 #include "../Buffer/buffer.h"
+#include "filecache.h"
 
+constexpr std::size_t GZIP_MIN_SIZE = 256;          // 小于这个大小的文件压缩省不了多少，不压缩
 
 class HttpResponse{
 public:
@@ -15,30 +19,49 @@ public:
 
     void Init(const std::string& src_dir, const std::string& path, bool is_keep_alive = false, int code = -1);
     void UnmapFile();
+    void SetCookie(const std::string& key, const std::string& value, int max_age_s);
+    void SetKeepAlive(int max, int timeout_s);
+    void SetBody(std::string body);
+    void SetAcceptGzip(bool accept_gzip);
     void MakeResponse(Buffer& buff);
     int GetCode() const;
     size_t GetFileLen() const;
     char* GetFile();
+    std::string GetFileType();
+    static std::string FileType(const std::string& path);
+    static bool IsCompressible(const std::string& path, std::size_t size);
 
 private:
     void ErrorHtml();
     void AddStateLine(Buffer& buff);
     void AddHeader(Buffer& buff);
     void AddContent(Buffer& buff);
+    void NegotiateEncoding();
+    std::string FilePath() const;
 
+    int StatFile();
     void ErrorContent(Buffer& buff,const std::string& message);
-    std::string GetFileType();
 
 private:
     int code_;
     bool is_keep_alive_;
     std::string path_;
     std::string src_dir_;
+    std::string cookie_;            // Set-Cookie的内容，为空则不发送
+    int keep_alive_max_;            // 这条连接还能处理的请求数，0为不限制
+    int keep_alive_timeout_s_;      // 空闲连接保持的秒数，0为不发送Keep-Alive头
     char* mm_file_;
     struct stat mm_file_stat_;
+    std::shared_ptr<const CachedFile> cached_file_;     // 命中文件缓存时代替mm_file_
+    bool has_body_;                 // 响应内容由程序生成，不读文件
+    std::string body_;
+    bool accept_gzip_;              // 客户端的Accept-Encoding接受gzip
+    bool is_gzip_;                  // 发送的是文件的gzip版本
+    bool vary_;                     // 响应内容随Accept-Encoding变化，需要发送Vary头
 
     static const std::unordered_map<std::string, std::string> SUFFIX_TYPE;      // 后缀类型集
     static const std::unordered_map<int, std::string> CODE_STATUS;              // 编码状态集
     static const std::unordered_map<int, std::string> CODE_PATH;                // 编码路径集
+    static const std::unordered_set<std::string> GZIP_TYPE;                     // 值得压缩的类型
 };
 #endif 
\ No newline at end of file
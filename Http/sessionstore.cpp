@@ -0,0 +1,112 @@
+#include "sessionstore.h"
+#include <cassert>
+#include <cstdio>
+#include <functional>
+#include <random>
+
+SessionStore::SessionStore() :
+    ttl_ms_(0),
+    is_open_(false)
+{
+
+}
+
+SessionStore& SessionStore::Instance(){
+    static SessionStore ins;
+    return ins;
+}
+
+void SessionStore::Init(int ttl_ms){
+    assert(ttl_ms > 0);
+    ttl_ms_ = ttl_ms;
+    is_open_.store(true);
+}
+
+bool SessionStore::IsOpen(){
+    return is_open_.load();
+}
+
+int SessionStore::GetTtlMs() const{
+    return ttl_ms_;
+}
+
+SessionStore::Shard& SessionStore::GetShard(const std::string& sid){
+    return shards_[std::hash<std::string>()(sid) % SESSION_SHARD_NUM];
+}
+
+// 128位随机数作为会话id，用十六进制表示
+std::string SessionStore::NewId(){
+    thread_local std::random_device rd;
+    char id[33];
+    for(int i = 0; i < 4; i++){
+        snprintf(id + i * 8, 9, "%08x", (unsigned int)rd());
+    }
+    return std::string(id, 32);
+}
+
+std::string SessionStore::Create(const std::string& user){
+    std::string sid = NewId();
+    Shard& shard = GetShard(sid);
+    std::lock_guard<std::mutex> lck(shard.mtx);
+    Session& session = shard.sessions[sid];
+    session.user = user;
+    session.expires = std::chrono::steady_clock::now() + std::chrono::milliseconds(ttl_ms_);
+    return sid;
+}
+
+// 会话有效则返回用户名，并且顺延过期时间
+bool SessionStore::Get(const std::string& sid, std::string* user){
+    if(sid.empty())
+        return false;
+
+    auto now = std::chrono::steady_clock::now();
+    Shard& shard = GetShard(sid);
+    std::lock_guard<std::mutex> lck(shard.mtx);
+    auto it = shard.sessions.find(sid);
+    if(it == shard.sessions.end())
+        return false;
+
+    if(it->second.expires <= now){          // 已经过期，只是还没被定时器清理
+        shard.sessions.erase(it);
+        return false;
+    }
+
+    it->second.expires = now + std::chrono::milliseconds(ttl_ms_);
+    if(user)
+        *user = it->second.user;
+    return true;
+}
+
+void SessionStore::Remove(const std::string& sid){
+    Shard& shard = GetShard(sid);
+    std::lock_guard<std::mutex> lck(shard.mtx);
+    shard.sessions.erase(sid);
+}
+
+// 由定时器调用，逐个分片清理过期的会话，返回清理的数量
+int SessionStore::Expire(){
+    int count = 0;
+    auto now = std::chrono::steady_clock::now();
+    for(int i = 0; i < SESSION_SHARD_NUM; i++){
+        std::lock_guard<std::mutex> lck(shards_[i].mtx);
+        auto& sessions = shards_[i].sessions;
+        for(auto it = sessions.begin(); it != sessions.end();){
+            if(it->second.expires <= now){
+                it = sessions.erase(it);
+                count++;
+            }else{
+                ++it;
+            }
+        }
+    }
+    return count;
+}
+
+std::size_t SessionStore::Size(){
+    std::size_t size = 0;
+    for(int i = 0; i < SESSION_SHARD_NUM; i++){
+        std::lock_guard<std::mutex> lck(shards_[i].mtx);
+        size += shards_[i].sessions.size();
+    }
+    return size;
+}
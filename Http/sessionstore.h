@@ -0,0 +1,50 @@
+#ifndef SESSIONSTORE_H
+#define SESSIONSTORE_H
+#include "../common/nocopy.h"
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+constexpr int SESSION_SHARD_NUM = 16;
+
+// 登录会话表，按会话id分片，每个分片一把锁。过期由服务器的定时器定期清理，查询时也会检查过期
+class SessionStore : public NoCopy{
+public:
+    static SessionStore& Instance();
+
+    void Init(int ttl_ms);
+    bool IsOpen();
+    std::string Create(const std::string& user);
+    bool Get(const std::string& sid, std::string* user);
+    void Remove(const std::string& sid);
+    int Expire();
+    std::size_t Size();
+    int GetTtlMs() const;
+
+private:
+    struct Session{
+        std::string user;
+        std::chrono::steady_clock::time_point expires;
+    };
+
+    struct Shard{
+        std::mutex mtx;
+        std::unordered_map<std::string, Session> sessions;
+    };
+
+private:
+    SessionStore();
+    ~SessionStore() = default;
+    Shard& GetShard(const std::string& sid);
+    static std::string NewId();
+
+private:
+    int ttl_ms_;
+    std::atomic_bool is_open_;
+    Shard shards_[SESSION_SHARD_NUM];
+};
+
+#endif
@@ -0,0 +1,206 @@
+#ifdef TINYWEB_ACCOUNTING
+#include "accounting.h"
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <new>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+thread_local int Accounting::phase_ = AP_OTHER;
+std::atomic<uint64_t> Accounting::counts_[AP_PHASE_NUM][AC_CALL_NUM];
+std::atomic<uint64_t> Accounting::requests_(0);
+
+static const char* PHASE_NAMES[AP_PHASE_NUM] = {
+    "other", "accept", "read", "parse", "sql", "response", "write", "close",
+};
+
+static const char* CALL_NAMES[AC_CALL_NUM] = {
+    "accept4", "read", "readv", "recv", "write", "writev", "send", "open", "close", "stat", "fstat",
+    "mmap", "munmap", "epoll_ctl", "epoll_wait", "fcntl", "setsockopt", "getpeername", "io_uring_enter", "new", "new_bytes",
+};
+
+// 每个阶段一行，只列出出现过的调用，数值是平均每个请求的次数
+std::string Accounting::Report(){
+    uint64_t requests = requests_.load();
+    double per = requests > 0 ? 1.0 / requests : 0;
+    uint64_t total[AC_CALL_NUM] = {0};
+    std::string out;
+    char buf[64];
+    for(int p = 0; p < AP_PHASE_NUM; ++p){
+        std::string line;
+        for(int c = 0; c < AC_CALL_NUM; ++c){
+            uint64_t n = counts_[p][c].load();
+            total[c] += n;
+            if(n == 0)
+                continue;
+            snprintf(buf, sizeof(buf), " %s %.2f", CALL_NAMES[c], n * per);
+            line += buf;
+        }
+        if(!line.empty())
+            out += std::string("  ") + PHASE_NAMES[p] + ":" + line + "\n";
+    }
+
+    uint64_t syscalls = 0;
+    for(int c = 0; c < AC_NEW; ++c)
+        syscalls += total[c];
+    snprintf(buf, sizeof(buf), "requests %llu, per request:", (unsigned long long)requests);
+    std::string head = buf;
+    snprintf(buf, sizeof(buf), " syscalls %.2f, new %.2f (%.0f bytes)\n",
+            syscalls * per, total[AC_NEW] * per, total[AC_NEW_BYTES] * per);
+    return head + buf + out;
+}
+
+// 链接时加上-Wl,--wrap=<name>，服务器对<name>的调用会链接到__wrap_<name>，原函数是__real_<name>
+extern "C" {
+
+int __real_accept4(int fd, struct sockaddr* addr, socklen_t* len, int flags);
+ssize_t __real_read(int fd, void* buf, size_t len);
+ssize_t __real_readv(int fd, const struct iovec* iov, int cnt);
+ssize_t __real_recv(int fd, void* buf, size_t len, int flags);
+ssize_t __real_write(int fd, const void* buf, size_t len);
+ssize_t __real_writev(int fd, const struct iovec* iov, int cnt);
+ssize_t __real_send(int fd, const void* buf, size_t len, int flags);
+int __real_open(const char* path, int flags, ...);
+int __real_close(int fd);
+int __real_stat(const char* path, struct stat* st);
+int __real_fstat(int fd, struct stat* st);
+void* __real_mmap(void* addr, size_t len, int prot, int flags, int fd, off_t offset);
+int __real_munmap(void* addr, size_t len);
+int __real_epoll_ctl(int epfd, int op, int fd, struct epoll_event* ev);
+int __real_epoll_wait(int epfd, struct epoll_event* evs, int max, int timeout);
+int __real_fcntl(int fd, int cmd, ...);
+int __real_setsockopt(int fd, int level, int name, const void* val, socklen_t len);
+int __real_getpeername(int fd, struct sockaddr* addr, socklen_t* len);
+
+int __wrap_accept4(int fd, struct sockaddr* addr, socklen_t* len, int flags){
+    Accounting::Count(AC_ACCEPT4);
+    return __real_accept4(fd, addr, len, flags);
+}
+
+ssize_t __wrap_read(int fd, void* buf, size_t len){
+    Accounting::Count(AC_READ);
+    return __real_read(fd, buf, len);
+}
+
+ssize_t __wrap_readv(int fd, const struct iovec* iov, int cnt){
+    Accounting::Count(AC_READV);
+    return __real_readv(fd, iov, cnt);
+}
+
+ssize_t __wrap_recv(int fd, void* buf, size_t len, int flags){
+    Accounting::Count(AC_RECV);
+    return __real_recv(fd, buf, len, flags);
+}
+
+ssize_t __wrap_write(int fd, const void* buf, size_t len){
+    Accounting::Count(AC_WRITE);
+    return __real_write(fd, buf, len);
+}
+
+ssize_t __wrap_writev(int fd, const struct iovec* iov, int cnt){
+    Accounting::Count(AC_WRITEV);
+    return __real_writev(fd, iov, cnt);
+}
+
+ssize_t __wrap_send(int fd, const void* buf, size_t len, int flags){
+    Accounting::Count(AC_SEND);
+    return __real_send(fd, buf, len, flags);
+}
+
+int __wrap_open(const char* path, int flags, ...){
+    mode_t mode = 0;
+    if(flags & (O_CREAT | O_TMPFILE)){
+        va_list args;
+        va_start(args, flags);
+        mode = va_arg(args, mode_t);
+        va_end(args);
+    }
+    Accounting::Count(AC_OPEN);
+    return __real_open(path, flags, mode);
+}
+
+int __wrap_close(int fd){
+    Accounting::Count(AC_CLOSE);
+    return __real_close(fd);
+}
+
+int __wrap_stat(const char* path, struct stat* st){
+    Accounting::Count(AC_STAT);
+    return __real_stat(path, st);
+}
+
+int __wrap_fstat(int fd, struct stat* st){
+    Accounting::Count(AC_FSTAT);
+    return __real_fstat(fd, st);
+}
+
+void* __wrap_mmap(void* addr, size_t len, int prot, int flags, int fd, off_t offset){
+    Accounting::Count(AC_MMAP);
+    return __real_mmap(addr, len, prot, flags, fd, offset);
+}
+
+int __wrap_munmap(void* addr, size_t len){
+    Accounting::Count(AC_MUNMAP);
+    return __real_munmap(addr, len);
+}
+
+int __wrap_epoll_ctl(int epfd, int op, int fd, struct epoll_event* ev){
+    Accounting::Count(AC_EPOLL_CTL);
+    return __real_epoll_ctl(epfd, op, fd, ev);
+}
+
+int __wrap_epoll_wait(int epfd, struct epoll_event* evs, int max, int timeout){
+    Accounting::Count(AC_EPOLL_WAIT);
+    return __real_epoll_wait(epfd, evs, max, timeout);
+}
+
+// 服务器只用到F_GETFL/F_SETFL，第三个参数按整数转发
+int __wrap_fcntl(int fd, int cmd, ...){
+    va_list args;
+    va_start(args, cmd);
+    long arg = va_arg(args, long);
+    va_end(args);
+    Accounting::Count(AC_FCNTL);
+    return __real_fcntl(fd, cmd, arg);
+}
+
+int __wrap_setsockopt(int fd, int level, int name, const void* val, socklen_t len){
+    Accounting::Count(AC_SETSOCKOPT);
+    return __real_setsockopt(fd, level, name, val, len);
+}
+
+int __wrap_getpeername(int fd, struct sockaddr* addr, socklen_t* len){
+    Accounting::Count(AC_GETPEERNAME);
+    return __real_getpeername(fd, addr, len);
+}
+
+}
+
+void* operator new(std::size_t size){
+    Accounting::Count(AC_NEW);
+    Accounting::Count(AC_NEW_BYTES, size);
+    void* p = malloc(size ? size : 1);
+    if(!p)
+        throw std::bad_alloc();
+    return p;
+}
+
+void* operator new[](std::size_t size){
+    return operator new(size);
+}
+
+void operator delete(void* p) noexcept {
+    free(p);
+}
+
+void operator delete[](void* p) noexcept {
+    free(p);
+}
+
+#endif
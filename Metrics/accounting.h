@@ -0,0 +1,94 @@
+#ifndef ACCOUNTING_H
+#define ACCOUNTING_H
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+// 系统调用和operator new归属的阶段，没有进入任何阶段的算在other，主要是事件循环和定时器
+enum ACCOUNT_PHASE{
+    AP_OTHER = 0,
+    AP_ACCEPT,              // accept4以及新连接的设置
+    AP_READ,                // HttpConn::read
+    AP_PARSE,               // 解析请求
+    AP_SQL,                 // 数据库校验
+    AP_RESPONSE,            // 生成响应，包括stat/open/mmap
+    AP_WRITE,               // HttpConn::write
+    AP_CLOSE,               // 关闭连接
+    AP_PHASE_NUM
+};
+
+// 统计的调用，都是服务器自己直接发出的，glibc内部的调用(例如日志的fwrite)不计入
+enum ACCOUNT_CALL{
+    AC_ACCEPT4 = 0,
+    AC_READ,
+    AC_READV,
+    AC_RECV,
+    AC_WRITE,
+    AC_WRITEV,
+    AC_SEND,
+    AC_OPEN,
+    AC_CLOSE,
+    AC_STAT,
+    AC_FSTAT,
+    AC_MMAP,
+    AC_MUNMAP,
+    AC_EPOLL_CTL,
+    AC_EPOLL_WAIT,
+    AC_FCNTL,
+    AC_SETSOCKOPT,
+    AC_GETPEERNAME,
+    AC_IO_URING_ENTER,      // 通过syscall()发起，由UringPoller自己计数
+    AC_NEW,                 // operator new和new[]的次数
+    AC_NEW_BYTES,           // operator new申请的字节数
+    AC_CALL_NUM
+};
+
+#ifdef TINYWEB_ACCOUNTING
+
+// 调试和压测用的调用计数。链接时用--wrap替换服务器发出的系统调用，并替换全局operator new，
+// 每次调用按当前线程所处的阶段计数，关闭时输出平均每个请求的次数，作为每个请求的开销预算。
+// 只在cmake -DACCOUNTING=ON时编译，正常构建中下面的宏都是空的
+class Accounting{
+public:
+    static void Count(ACCOUNT_CALL call, uint64_t n = 1){
+        counts_[phase_][call].fetch_add(n, std::memory_order_relaxed);
+    }
+
+    static void RequestDone(){
+        requests_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    static std::string Report();
+
+    // 进入一个阶段，离开作用域时恢复上一个阶段，可以嵌套
+    class Scope{
+    public:
+        explicit Scope(ACCOUNT_PHASE phase) : prev_(phase_) {
+            phase_ = phase;
+        }
+        ~Scope(){
+            phase_ = prev_;
+        }
+    private:
+        int prev_;
+    };
+
+private:
+    static thread_local int phase_;
+    static std::atomic<uint64_t> counts_[AP_PHASE_NUM][AC_CALL_NUM];
+    static std::atomic<uint64_t> requests_;
+};
+
+#define ACCOUNT_PHASE(phase) Accounting::Scope account_scope_(phase)
+#define ACCOUNT_REQUEST() Accounting::RequestDone()
+#define ACCOUNT_SYSCALL(call) Accounting::Count(call)
+
+#else
+
+#define ACCOUNT_PHASE(phase) do{}while(0)
+#define ACCOUNT_REQUEST() do{}while(0)
+#define ACCOUNT_SYSCALL(call) do{}while(0)
+
+#endif
+
+#endif
@@ -0,0 +1,168 @@
+#include "metrics.h"
+#include <cstdio>
+
+static const int STATUS_CODES[METRIC_STATUS_NUM - 1] = { 200, 400, 403, 404 };
+
+// 和HttpResponse::SUFFIX_TYPE中的类型对应，最后一个为其他
+static const char* MIME_TYPES[METRIC_MIME_NUM] = {
+    "text/html", "text/xml", "application/xhtml+xml", "text/plain", "application/rtf", "application/pdf",
+    "application/nsword", "image/png", "image/gif", "image/jpeg", "audio/basic", "video/mpeg",
+    "video/x-msvideo", "application/x-gzip", "application/x-tar", "text/css", "text/javascript", "image/svg+xml",
+    "other",
+};
+
+static const char* COUNTER_NAMES[MC_COUNTER_NUM][2] = {
+    { "tinyweb_accepts_total", "Connections accepted." },
+    { "tinyweb_rejects_total", "Connections rejected with 503 because the server was full." },
+    { "tinyweb_parse_errors_total", "Requests that failed to parse." },
+    { "tinyweb_sent_bytes_total", "Response bytes written to sockets." },
+    { "tinyweb_timer_expirations_total", "Timer callbacks fired." },
+    { "tinyweb_timeouts_total", "Connections closed because a phase deadline passed." },
+    { "tinyweb_inline_requests_total", "Requests served directly on the event loop thread." },
+    { "tinyweb_offloaded_events_total", "Connection events handed to the thread pool." },
+    { "tinyweb_gzip_responses_total", "Responses sent gzip encoded." },
+    { "tinyweb_gzip_original_bytes_total", "Uncompressed size of the files sent gzip encoded." },
+    { "tinyweb_gzip_bytes_total", "Compressed bytes sent for gzip encoded responses." },
+};
+
+Metrics& Metrics::Instance(){
+    static Metrics ins;
+    return ins;
+}
+
+MetricShard* Metrics::NewShard(){
+    MetricShard* shard = new MetricShard();         // 值初始化，全部为0
+    std::lock_guard<std::mutex> lck(mtx_);
+    shards_.push_back(shard);
+    return shard;
+}
+
+// 小于8的值每个值一个桶，之后每个2的幂区间分成8个桶
+int Metrics::BucketIndex(uint64_t us){
+    if(us < METRIC_SUB_NUM)
+        return (int)us;
+
+    int exp = 63 - __builtin_clzll(us);
+    if(exp > METRIC_MAX_EXP)
+        return METRIC_BUCKET_NUM - 1;
+    int sub = (int)(us >> (exp - METRIC_SUB_BITS)) & (METRIC_SUB_NUM - 1);
+    return (exp - METRIC_SUB_BITS + 1) * METRIC_SUB_NUM + sub;
+}
+
+// 桶里最大的值，Prometheus的le是包含上界的
+uint64_t Metrics::BucketUpper(int index){
+    if(index < METRIC_SUB_NUM)
+        return index;
+
+    int exp = index / METRIC_SUB_NUM + METRIC_SUB_BITS - 1;
+    uint64_t sub = index % METRIC_SUB_NUM;
+    uint64_t lower = (METRIC_SUB_NUM + sub) << (exp - METRIC_SUB_BITS);
+    return lower + (1ull << (exp - METRIC_SUB_BITS)) - 1;
+}
+
+int Metrics::StatusIndex(int code){
+    for(int i = 0; i < METRIC_STATUS_NUM - 1; ++i){
+        if(STATUS_CODES[i] == code)
+            return i;
+    }
+    return METRIC_STATUS_NUM - 1;
+}
+
+int Metrics::MimeIndex(const std::string& type){
+    for(int i = 0; i < METRIC_MIME_NUM - 1; ++i){
+        if(type == MIME_TYPES[i])
+            return i;
+    }
+    return METRIC_MIME_NUM - 1;
+}
+
+void Metrics::AddGauge(const std::string& name, const std::string& help, std::function<double()> read){
+    std::lock_guard<std::mutex> lck(mtx_);
+    collectors_.push_back({name, help, "gauge", read});
+}
+
+// 已有模块自己维护的累计值，比如文件缓存的命中数
+void Metrics::AddCounter(const std::string& name, const std::string& help, std::function<double()> read){
+    std::lock_guard<std::mutex> lck(mtx_);
+    collectors_.push_back({name, help, "counter", read});
+}
+
+uint64_t Metrics::Get(METRIC_COUNTER counter){
+    std::lock_guard<std::mutex> lck(mtx_);
+    uint64_t sum = 0;
+    for(MetricShard* shard : shards_)
+        sum += shard->counters[counter].load(std::memory_order_relaxed);
+    return sum;
+}
+
+static void AppendHeader(std::string& out, const std::string& name, const std::string& help, const char* type){
+    out += "# HELP " + name + " " + help + "\n";
+    out += "# TYPE " + name + " " + type + "\n";
+}
+
+// 只输出有数据的桶，桶的计数是累积的，所以省略空桶不影响分位数计算
+void Metrics::RenderHistogram(std::string& out, METRIC_HISTOGRAM histogram, const char* name, const char* help){
+    std::vector<uint64_t> buckets(METRIC_BUCKET_NUM, 0);
+    uint64_t sum = 0;
+    for(MetricShard* shard : shards_){
+        for(int i = 0; i < METRIC_BUCKET_NUM; ++i)
+            buckets[i] += shard->buckets[histogram][i].load(std::memory_order_relaxed);
+        sum += shard->sums[histogram].load(std::memory_order_relaxed);
+    }
+
+    AppendHeader(out, name, help, "histogram");
+    char line[128];
+    uint64_t count = 0;
+    for(int i = 0; i < METRIC_BUCKET_NUM; ++i){
+        if(buckets[i] == 0)
+            continue;
+        count += buckets[i];
+        snprintf(line, sizeof(line), "%s_bucket{le=\"%.6f\"} %llu\n", name, BucketUpper(i) / 1e6, (unsigned long long)count);
+        out += line;
+    }
+    snprintf(line, sizeof(line), "%s_bucket{le=\"+Inf\"} %llu\n", name, (unsigned long long)count);
+    out += line;
+    snprintf(line, sizeof(line), "%s_sum %.6f\n%s_count %llu\n", name, sum / 1e6, name, (unsigned long long)count);
+    out += line;
+}
+
+// 生成Prometheus文本格式
+std::string Metrics::Render(){
+    std::lock_guard<std::mutex> lck(mtx_);
+    std::string out;
+    char line[256];
+
+    for(int c = 0; c < MC_COUNTER_NUM; ++c){
+        uint64_t sum = 0;
+        for(MetricShard* shard : shards_)
+            sum += shard->counters[c].load(std::memory_order_relaxed);
+        AppendHeader(out, COUNTER_NAMES[c][0], COUNTER_NAMES[c][1], "counter");
+        snprintf(line, sizeof(line), "%s %llu\n", COUNTER_NAMES[c][0], (unsigned long long)sum);
+        out += line;
+    }
+
+    AppendHeader(out, "tinyweb_responses_total", "Responses by status code and content type.", "counter");
+    for(int s = 0; s < METRIC_STATUS_NUM; ++s){
+        for(int m = 0; m < METRIC_MIME_NUM; ++m){
+            uint64_t sum = 0;
+            for(MetricShard* shard : shards_)
+                sum += shard->requests[s][m].load(std::memory_order_relaxed);
+            if(sum == 0)
+                continue;
+            std::string code = s < METRIC_STATUS_NUM - 1 ? std::to_string(STATUS_CODES[s]) : "other";
+            snprintf(line, sizeof(line), "tinyweb_responses_total{code=\"%s\",type=\"%s\"} %llu\n",
+                    code.c_str(), MIME_TYPES[m], (unsigned long long)sum);
+            out += line;
+        }
+    }
+
+    RenderHistogram(out, MH_REQUEST, "tinyweb_request_duration_seconds", "Time from the first request byte to the last response byte.");
+    RenderHistogram(out, MH_SQL_WAIT, "tinyweb_sql_conn_wait_seconds", "Time spent waiting for a connection from the SQL pool.");
+
+    for(const Collector& collector : collectors_){
+        AppendHeader(out, collector.name, collector.help, collector.type);
+        snprintf(line, sizeof(line), "%s %.17g\n", collector.name.c_str(), collector.read());
+        out += line;
+    }
+    return out;
+}
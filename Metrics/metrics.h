@@ -0,0 +1,119 @@
+#ifndef METRICS_H
+#define METRICS_H
+#include "nocopy.h"
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+constexpr const char* METRICS_PATH = "/metrics";        // 保留路径，开启指标后返回Prometheus文本格式
+
+// 计数器，每个线程累加自己的分片，抓取时求和
+enum METRIC_COUNTER{
+    MC_ACCEPT = 0,          // 接受的连接
+    MC_REJECT,              // 过载时直接回503拒绝的连接
+    MC_PARSE_ERROR,         // 请求解析失败
+    MC_BYTES_SENT,          // 写出的响应字节数
+    MC_TIMER_EXPIRE,        // 到期执行的定时器
+    MC_TIMEOUT,             // 因为阶段超时关闭的连接
+    MC_INLINE,              // 事件循环线程直接处理的请求
+    MC_OFFLOAD,             // 交给线程池的事件
+    MC_GZIP,                // 发送gzip版本的响应
+    MC_GZIP_ORIGINAL_BYTES, // 这些响应对应的原文件字节数
+    MC_GZIP_BYTES,          // 这些响应实际发送的压缩后字节数
+    MC_COUNTER_NUM
+};
+
+// 延迟直方图，单位微秒
+enum METRIC_HISTOGRAM{
+    MH_REQUEST = 0,         // 从收到请求的第一个字节到响应写完
+    MH_SQL_WAIT,            // 从数据库连接池取连接的等待时间
+    MH_HISTOGRAM_NUM
+};
+
+constexpr int METRIC_SUB_BITS = 3;                                  // 每个2的幂区间再等分成8份，相对误差不超过12.5%
+constexpr int METRIC_SUB_NUM = 1 << METRIC_SUB_BITS;
+constexpr int METRIC_MAX_EXP = 32;                                  // 超过2^32微秒(约71分钟)的值都算在最后一个桶
+constexpr int METRIC_BUCKET_NUM = (METRIC_MAX_EXP - METRIC_SUB_BITS + 2) * METRIC_SUB_NUM;
+constexpr int METRIC_STATUS_NUM = 5;                                // 200 400 403 404 其他
+constexpr int METRIC_MIME_NUM = 19;                                 // 响应的类型，最后一个为其他
+
+// 一个线程的全部指标。只有所属线程写，用relaxed的load+store代替原子加，没有锁前缀也没有缓存行争用
+struct MetricShard{
+    std::atomic<uint64_t> counters[MC_COUNTER_NUM];
+    std::atomic<uint64_t> requests[METRIC_STATUS_NUM][METRIC_MIME_NUM];
+    std::atomic<uint64_t> buckets[MH_HISTOGRAM_NUM][METRIC_BUCKET_NUM];
+    std::atomic<uint64_t> sums[MH_HISTOGRAM_NUM];
+};
+
+// 指标注册表。计数和直方图分线程累加，线程第一次记录时注册分片，线程退出后分片保留，数值不会丢失。
+// 连接数、队列长度这类已有的状态在抓取时通过回调读取
+class Metrics : public NoCopy{
+public:
+    static Metrics& Instance();
+
+    static void Add(METRIC_COUNTER counter, uint64_t n = 1){
+        Bump(Shard()->counters[counter], n);
+    }
+
+    static void Observe(METRIC_HISTOGRAM histogram, uint64_t us){
+        MetricShard* shard = Shard();
+        Bump(shard->buckets[histogram][BucketIndex(us)], 1);
+        Bump(shard->sums[histogram], us);
+    }
+
+    static void Request(int code, const std::string& type){
+        Bump(Shard()->requests[StatusIndex(code)][MimeIndex(type)], 1);
+    }
+
+    static int64_t NowUs(){
+        return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    static int BucketIndex(uint64_t us);
+    static uint64_t BucketUpper(int index);
+
+    void AddGauge(const std::string& name, const std::string& help, std::function<double()> read);
+    void AddCounter(const std::string& name, const std::string& help, std::function<double()> read);
+    uint64_t Get(METRIC_COUNTER counter);
+    std::string Render();
+
+private:
+    struct Collector{
+        std::string name;
+        std::string help;
+        const char* type;
+        std::function<double()> read;
+    };
+
+private:
+    Metrics() = default;
+    ~Metrics() = default;
+
+    static void Bump(std::atomic<uint64_t>& value, uint64_t n){
+        value.store(value.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+    static MetricShard* Shard(){
+        static thread_local MetricShard* shard = nullptr;
+        if(!shard)
+            shard = Instance().NewShard();
+        return shard;
+    }
+
+    static int StatusIndex(int code);
+    static int MimeIndex(const std::string& type);
+    MetricShard* NewShard();
+    void RenderHistogram(std::string& out, METRIC_HISTOGRAM histogram, const char* name, const char* help);
+
+private:
+    std::mutex mtx_;
+    std::vector<MetricShard*> shards_;
+    std::vector<Collector> collectors_;
+};
+
+#endif
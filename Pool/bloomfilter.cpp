@@ -0,0 +1,81 @@
+#include "bloomfilter.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <functional>
+
+CountingBloomFilter::CountingBloomFilter(std::size_t counter_num, int hash_num) :
+    counters_(counter_num, 0),
+    hash_num_(hash_num),
+    size_(0)
+{
+    assert(counter_num > 0 && hash_num > 0);
+}
+
+// 双重哈希，第i个位置为 h1 + i * h2
+void CountingBloomFilter::Hash(const std::string& key, uint64_t* h1, uint64_t* h2) const{
+    *h1 = std::hash<std::string>()(key);
+
+    uint64_t fnv = 14695981039346656037ULL;         // FNV-1a
+    for(unsigned char ch : key){
+        fnv ^= ch;
+        fnv *= 1099511628211ULL;
+    }
+    *h2 = fnv | 1;
+}
+
+void CountingBloomFilter::Add(const std::string& key){
+    uint64_t h1, h2;
+    Hash(key, &h1, &h2);
+    for(int i = 0; i < hash_num_; i++){
+        uint8_t& counter = counters_[(h1 + i * h2) % counters_.size()];
+        if(counter < UINT8_MAX)             // 计数器饱和后不再增加
+            counter++;
+    }
+    size_++;
+}
+
+void CountingBloomFilter::Remove(const std::string& key){
+    if(!MayContain(key))
+        return;
+
+    uint64_t h1, h2;
+    Hash(key, &h1, &h2);
+    for(int i = 0; i < hash_num_; i++){
+        uint8_t& counter = counters_[(h1 + i * h2) % counters_.size()];
+        if(counter < UINT8_MAX)             // 饱和的计数器不知道真实值，不能减
+            counter--;
+    }
+    if(size_ > 0)
+        size_--;
+}
+
+bool CountingBloomFilter::MayContain(const std::string& key) const{
+    uint64_t h1, h2;
+    Hash(key, &h1, &h2);
+    for(int i = 0; i < hash_num_; i++){
+        if(counters_[(h1 + i * h2) % counters_.size()] == 0)
+            return false;
+    }
+    return true;
+}
+
+void CountingBloomFilter::Clear(){
+    std::fill(counters_.begin(), counters_.end(), 0);
+    size_ = 0;
+}
+
+std::size_t CountingBloomFilter::Size() const{
+    return size_;
+}
+
+std::size_t CountingBloomFilter::CounterNum() const{
+    return counters_.size();
+}
+
+// 理论误判率 (1 - e^(-kn/m))^k
+double CountingBloomFilter::EstimateFpr() const{
+    double k = hash_num_;
+    double exponent = -k * (double)size_ / (double)counters_.size();
+    return std::pow(1.0 - std::exp(exponent), k);
+}
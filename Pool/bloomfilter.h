@@ -0,0 +1,32 @@
+#ifndef BLOOMFILTER_H
+#define BLOOMFILTER_H
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// 计数布隆过滤器，每个位置是一个8位计数器，支持删除。判定不存在则一定不存在，判定存在可能误判
+class CountingBloomFilter{
+public:
+    CountingBloomFilter(std::size_t counter_num = 1024, int hash_num = 7);
+    ~CountingBloomFilter() = default;
+
+    void Add(const std::string& key);
+    void Remove(const std::string& key);
+    bool MayContain(const std::string& key) const;
+    void Clear();
+
+    std::size_t Size() const;
+    std::size_t CounterNum() const;
+    double EstimateFpr() const;
+
+private:
+    void Hash(const std::string& key, uint64_t* h1, uint64_t* h2) const;
+
+private:
+    std::vector<uint8_t> counters_;
+    int hash_num_;
+    std::size_t size_;          // 插入的元素个数
+};
+
+#endif
@@ -0,0 +1,243 @@
+#include "registerbuffer.h"
+#include "sqlconnpool.h"
+#include "../Log/log.h"
+#include <cassert>
+#include <chrono>
+#include <mutex>
+#include <vector>
+
+RegisterBuffer::RegisterBuffer() :
+    batch_size_(64),
+    flush_ms_(200),
+    is_open_(false),
+    flush_thread_(nullptr),
+    flush_count_(0),
+    flush_rows_(0),
+    flush_us_(0),
+    max_batch_(0),
+    lost_count_(0)
+{
+
+}
+
+RegisterBuffer::~RegisterBuffer(){
+    Close();
+}
+
+RegisterBuffer& RegisterBuffer::Instance(){
+    static RegisterBuffer ins;
+    return ins;
+}
+
+void RegisterBuffer::Init(int batch_size, int flush_ms){
+    assert(batch_size > 0 && flush_ms > 0);
+    if(is_open_.load())
+        return;
+
+    batch_size_ = batch_size;
+    flush_ms_ = flush_ms;
+    is_open_.store(true);
+    flush_thread_.reset(new std::thread(&RegisterBuffer::FlushThread, this));
+    LOG_INFO("RegisterBuffer batch size: %d, flush interval: %dms", batch_size_, flush_ms_);
+}
+
+// 停止后台线程，并且把剩下的注册全部落库
+void RegisterBuffer::Close(){
+    if(!is_open_.exchange(false))
+        return;
+
+    cv_flush_.notify_all();
+    if(flush_thread_ && flush_thread_->joinable()){
+        flush_thread_->join();
+    }
+    flush_thread_.reset();
+}
+
+bool RegisterBuffer::IsOpen(){
+    return is_open_.load();
+}
+
+// 在还没落库的注册中查找用户
+bool RegisterBuffer::Find(const std::string& name, std::string* pwd){
+    std::lock_guard<std::mutex> lck(mtx_);
+    auto it = pending_.find(name);
+    if(it == pending_.end()){
+        it = flushing_.find(name);
+        if(it == flushing_.end())
+            return false;
+    }
+
+    if(pwd)
+        *pwd = it->second;
+    return true;
+}
+
+// 用户名已经在缓冲中就返回false，攒够一个批量就唤醒后台线程
+bool RegisterBuffer::Add(const std::string& name, const std::string& pwd){
+    std::lock_guard<std::mutex> lck(mtx_);
+    if(pending_.count(name) || flushing_.count(name))
+        return false;
+
+    pending_[name] = pwd;
+    if((int)pending_.size() >= batch_size_)
+        cv_flush_.notify_one();
+    return true;
+}
+
+// 取出所有还没落库的用户名
+void RegisterBuffer::GetNames(std::vector<std::string>* names){
+    assert(names);
+    std::lock_guard<std::mutex> lck(mtx_);
+    for(const auto& row : pending_){
+        names->push_back(row.first);
+    }
+    for(const auto& row : flushing_){
+        names->push_back(row.first);
+    }
+}
+
+void RegisterBuffer::FlushThread(){
+    while(true){
+        {
+            std::unique_lock<std::mutex> lck(mtx_);
+            cv_flush_.wait_for(lck, std::chrono::milliseconds(flush_ms_), [this](){
+                return !is_open_.load() || (int)pending_.size() >= batch_size_;
+            });
+        }
+
+        bool ok = Flush();
+        if(!is_open_.load()){
+            std::lock_guard<std::mutex> lck(mtx_);
+            if(!ok && !pending_.empty()){       // 关闭时数据库出错就不再重试
+                LOG_ERROR("RegisterBuffer closed, %d rows not flushed", (int)pending_.size());
+            }
+            if(!ok || pending_.empty())
+                break;
+        }
+    }
+}
+
+// 取出一个批量，拼成多行INSERT在一个事务中提交，失败则放回缓冲等下次重试
+bool RegisterBuffer::Flush(){
+    {
+        std::lock_guard<std::mutex> lck(mtx_);
+        if(pending_.empty())
+            return true;
+
+        auto it = pending_.begin();
+        for(int i = 0; i < batch_size_ && it != pending_.end(); i++){
+            flushing_.insert(*it);
+            it = pending_.erase(it);
+        }
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    MYSQL* sql = SqlConnPool::Instance().GetConn();
+    bool ok = (sql != nullptr);
+    int lost = 0;
+    if(ok){
+        std::string order = "INSERT IGNORE INTO user(username, password) VALUES";
+        std::vector<char> escaped;
+        bool first = true;
+        for(const auto& row : flushing_){
+            order += first ? "('" : ",('";
+            first = false;
+
+            escaped.resize(row.first.size() * 2 + 1);
+            mysql_real_escape_string(sql, escaped.data(), row.first.c_str(), row.first.size());
+            order += escaped.data();
+            order += "','";
+
+            escaped.resize(row.second.size() * 2 + 1);
+            mysql_real_escape_string(sql, escaped.data(), row.second.c_str(), row.second.size());
+            order += escaped.data();
+            order += "')";
+        }
+        LOG_DEBUG("%s", order.c_str());
+
+        mysql_autocommit(sql, false);
+        if(mysql_query(sql, order.c_str())){
+            LOG_ERROR("Register flush error: %s", mysql_error(sql));
+            mysql_rollback(sql);
+            ok = false;
+        }else{
+            // INSERT IGNORE会跳过冲突的行，插入的行数不够说明有注册在确认之后才撞上了已有用户
+            if(mysql_affected_rows(sql) < flushing_.size())
+                lost = CheckLost(sql);
+            if(mysql_commit(sql)){
+                LOG_ERROR("Register flush error: %s", mysql_error(sql));
+                mysql_rollback(sql);
+                ok = false;
+            }
+        }
+        mysql_autocommit(sql, true);
+        SqlConnPool::Instance().FreeConn(sql);
+    }
+
+    std::lock_guard<std::mutex> lck(mtx_);
+    int batch = flushing_.size();
+    if(ok){
+        uint64_t us = std::chrono::duration_cast<std::chrono::microseconds>(
+                        std::chrono::steady_clock::now() - start).count();
+        flush_count_++;
+        flush_rows_ += batch - lost;
+        flush_us_ += us;
+        if(batch > max_batch_.load())
+            max_batch_.store(batch);
+        LOG_INFO("Register flush batch: %d, cost: %llu us", batch, (unsigned long long)us);
+    }else{
+        pending_.insert(flushing_.begin(), flushing_.end());
+        LOG_WARN("Register flush failed, %d rows wait for retry", batch);
+    }
+    flushing_.clear();
+    return ok;
+}
+
+// 逐个按用户名原样比较(BINARY，不受排序规则影响)，库里没有这一行或者密码不同就是被忽略的注册。
+// 只在插入行数不够时执行，这些用户已经收到注册成功，只能记录下来
+int RegisterBuffer::CheckLost(MYSQL* sql){
+    int lost = 0;
+    std::vector<char> escaped;
+    for(const auto& row : flushing_){
+        escaped.resize(row.first.size() * 2 + 1);
+        mysql_real_escape_string(sql, escaped.data(), row.first.c_str(), row.first.size());
+        std::string order = "SELECT password FROM user WHERE BINARY username='";
+        order += escaped.data();
+        order += "' LIMIT 1";
+        if(mysql_query(sql, order.c_str())){
+            LOG_ERROR("Register check error: %s", mysql_error(sql));
+            break;
+        }
+
+        MYSQL_RES* res = mysql_store_result(sql);
+        MYSQL_ROW mysql_row = res ? mysql_fetch_row(res) : nullptr;
+        bool saved = mysql_row && mysql_row[0] && row.second == mysql_row[0];
+        mysql_free_result(res);
+        if(!saved){
+            lost++;
+            LOG_ERROR("Register of %s was acknowledged but conflicts with an existing user, not saved", row.first.c_str());
+        }
+    }
+    lost_count_ += lost;
+    return lost;
+}
+
+uint64_t RegisterBuffer::GetFlushCount() const{
+    return flush_count_.load();
+}
+
+uint64_t RegisterBuffer::GetFlushRows() const{
+    return flush_rows_.load();
+}
+
+uint64_t RegisterBuffer::GetFlushUs() const{
+    return flush_us_.load();
+}
+
+int RegisterBuffer::GetMaxBatch() const{
+    return max_batch_.load();
+}
+
+uint64_t RegisterBuffer::GetLostCount() const{
+    return lost_count_.load();
+}
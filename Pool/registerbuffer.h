@@ -0,0 +1,57 @@
+#ifndef REGISTERBUFFER_H
+#define REGISTERBUFFER_H
+#include "nocopy.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "mysql.h"
+
+// 注册写回缓冲：注册的用户先放进内存表，登录可以立刻查到，后台线程按批量大小或者时间间隔合并成一条多行INSERT在一个事务里落库
+class RegisterBuffer : public NoCopy{
+public:
+    static RegisterBuffer& Instance();
+
+    void Init(int batch_size, int flush_ms);
+    void Close();
+    bool IsOpen();
+    bool Find(const std::string& name, std::string* pwd);
+    bool Add(const std::string& name, const std::string& pwd);
+    void GetNames(std::vector<std::string>* names);
+
+    uint64_t GetFlushCount() const;
+    uint64_t GetFlushRows() const;
+    uint64_t GetFlushUs() const;
+    int GetMaxBatch() const;
+    uint64_t GetLostCount() const;
+
+private:
+    RegisterBuffer();
+    ~RegisterBuffer();
+    void FlushThread();
+    bool Flush();
+    int CheckLost(MYSQL* sql);
+
+private:
+    int batch_size_;
+    int flush_ms_;
+    std::atomic_bool is_open_;
+    std::mutex mtx_;
+    std::condition_variable cv_flush_;
+    std::unordered_map<std::string, std::string> pending_;      // 等待落库的注册
+    std::unordered_map<std::string, std::string> flushing_;     // 正在写入数据库的注册，写完之前依然可见
+    std::unique_ptr<std::thread> flush_thread_;
+
+    std::atomic<uint64_t> flush_count_;         // 落库次数
+    std::atomic<uint64_t> flush_rows_;          // 落库总行数
+    std::atomic<uint64_t> flush_us_;            // 落库总耗时
+    std::atomic_int max_batch_;                 // 最大批量
+    std::atomic<uint64_t> lost_count_;          // 已经告诉客户端注册成功，落库时却和已有用户冲突被忽略的注册
+};
+
+#endif
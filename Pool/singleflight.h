@@ -0,0 +1,94 @@
+#ifndef SINGLEFLIGHT_H
+#define SINGLEFLIGHT_H
+#include "nocopy.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+// 请求合并：同一个key同时只有一个调用在执行，其他并发调用等待并共享这个结果。
+// 执行的调用抛出异常时，等待者收到同一个异常
+template <typename K, typename V>
+class SingleFlight : public NoCopy{
+public:
+    SingleFlight() : shared_count_(0) {}
+
+    V Do(const K& key, const std::function<V()>& func);
+    uint64_t GetSharedCount() const { return shared_count_.load(); }
+
+private:
+    struct Call{
+        std::mutex mtx;
+        std::condition_variable cv;
+        bool done = false;
+        V val;
+        std::exception_ptr error;       // 执行时抛出的异常，为空表示正常返回
+    };
+
+    void Finish(const K& key, const std::shared_ptr<Call>& call);
+
+private:
+    std::mutex mtx_;
+    std::unordered_map<K, std::shared_ptr<Call>> calls_;        // 正在执行中的调用
+    std::atomic<uint64_t> shared_count_;                        // 共享了别人结果的次数
+};
+
+template <typename K, typename V>
+V SingleFlight<K, V>::Do(const K& key, const std::function<V()>& func){
+    std::unique_lock<std::mutex> lck(mtx_);
+    auto it = calls_.find(key);
+    if(it != calls_.end()){                 // 已经有相同的调用在执行，等它的结果
+        std::shared_ptr<Call> call = it->second;
+        lck.unlock();
+
+        std::unique_lock<std::mutex> call_lck(call->mtx);
+        call->cv.wait(call_lck, [&call](){
+            return call->done;
+        });
+        shared_count_++;
+        if(call->error)
+            std::rethrow_exception(call->error);
+        return call->val;
+    }
+
+    std::shared_ptr<Call> call = std::make_shared<Call>();
+    calls_[key] = call;
+    lck.unlock();
+
+    V val;
+    try{
+        val = func();
+    }catch(...){
+        {
+            std::lock_guard<std::mutex> call_lck(call->mtx);
+            call->error = std::current_exception();
+        }
+        Finish(key, call);          // 不唤醒的话等待者会一直阻塞
+        throw;
+    }
+    {
+        std::lock_guard<std::mutex> call_lck(call->mtx);
+        call->val = val;
+    }
+    Finish(key, call);
+    return val;
+}
+
+// 唤醒等待者并删除这个调用
+template <typename K, typename V>
+void SingleFlight<K, V>::Finish(const K& key, const std::shared_ptr<Call>& call){
+    {
+        std::lock_guard<std::mutex> call_lck(call->mtx);
+        call->done = true;
+    }
+    call->cv.notify_all();
+
+    std::lock_guard<std::mutex> lck(mtx_);
+    calls_.erase(key);              // 之后的调用重新执行，不会拿到过期的结果
+}
+
+#endif
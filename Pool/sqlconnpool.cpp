@@ -1,5 +1,7 @@
 #include "sqlconnpool.h"
 #include "../Log/log.h"
+#include "../Metrics/metrics.h"
+#include "probes.h"
 #include "mysql.h"
 #include <cassert>
 #include <chrono>
@@ -43,6 +45,7 @@ void SqlConnPool::Init(const std::string host, const unsigned int port,
 }
 
 MYSQL* SqlConnPool::GetConn(){
+    int64_t start = Metrics::NowUs();
     std::unique_lock<std::mutex> lck(mtx_);
     while(conn_queue_.empty()){
         if(cv_con_.wait_for(lck, std::chrono::microseconds(TIMEOUT_COUNT)) == std::cv_status::timeout){
@@ -55,11 +58,15 @@ MYSQL* SqlConnPool::GetConn(){
 
     MYSQL* conn = conn_queue_.front();
     conn_queue_.pop();
+    int64_t wait_us = Metrics::NowUs() - start;
+    Metrics::Observe(MH_SQL_WAIT, wait_us);
+    TW_PROBE2(sql__acquire, conn, wait_us);
     return conn;
 }
 
 void SqlConnPool::FreeConn(MYSQL* conn){
     assert(conn);
+    TW_PROBE1(sql__release, conn);
     std::lock_guard<std::mutex> lck(mtx_);
     
     if(is_close_.load())
@@ -0,0 +1,81 @@
+#include "sqlexecutor.h"
+#include "../Log/log.h"
+#include <cassert>
+#include <mutex>
+
+SqlExecutor::SqlExecutor() :
+    is_close_(false)
+{
+
+}
+
+SqlExecutor::~SqlExecutor(){
+    Close();
+}
+
+SqlExecutor& SqlExecutor::Instance(){
+    static SqlExecutor ins;
+    return ins;
+}
+
+// 数据库线程数量和连接池大小一致，每个线程最多同时占用一个连接
+void SqlExecutor::Init(int thread_num){
+    assert(thread_num > 0);
+    std::lock_guard<std::mutex> lck(mtx_);
+    if(!threads_.empty())
+        return;
+
+    is_close_.store(false);
+    for(int i = 0; i < thread_num; i++){
+        threads_.emplace_back(&SqlExecutor::Run, this);
+    }
+    LOG_INFO("SqlExecutor thread num: %d", thread_num);
+}
+
+void SqlExecutor::Commit(Task task){
+    {
+        std::lock_guard<std::mutex> lck(mtx_);
+        if(is_close_.load())
+            return;
+        tasks_.emplace(std::move(task));
+    }
+    cv_con_.notify_one();
+}
+
+// 关闭时先把队列中剩余的任务执行完，保证挂起的请求都能拿到结果
+void SqlExecutor::Close(){
+    {
+        std::lock_guard<std::mutex> lck(mtx_);
+        is_close_.store(true);
+    }
+    cv_con_.notify_all();
+    for(auto& td : threads_){
+        if(td.joinable())
+            td.join();
+    }
+    threads_.clear();
+}
+
+int SqlExecutor::PendingCount(){
+    std::lock_guard<std::mutex> lck(mtx_);
+    return tasks_.size();
+}
+
+void SqlExecutor::Run(){
+    while(true){
+        Task task;
+        {
+            std::unique_lock<std::mutex> lck(mtx_);
+            cv_con_.wait(lck, [this](){
+                return is_close_.load() || !tasks_.empty();
+            });
+
+            if(tasks_.empty())          // 只有关闭并且没有任务时才退出
+                return;
+
+            task = std::move(tasks_.front());
+            tasks_.pop();
+        }
+        task();
+    }
+}
@@ -0,0 +1,37 @@
+#ifndef SQLEXECUTOR_H
+#define SQLEXECUTOR_H
+#include "nocopy.h"
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+// 数据库任务执行器，使用少量专门的数据库线程执行会阻塞的sql操作，工作线程不再等待mysql返回
+class SqlExecutor : public NoCopy{
+public:
+    using Task = std::function<void()>;
+
+    static SqlExecutor& Instance();
+
+    void Init(int thread_num);
+    void Commit(Task task);
+    void Close();
+    int PendingCount();
+
+private:
+    SqlExecutor();
+    ~SqlExecutor();
+    void Run();
+
+private:
+    std::atomic_bool is_close_;
+    std::mutex mtx_;
+    std::condition_variable cv_con_;
+    std::queue<Task> tasks_;
+    std::vector<std::thread> threads_;
+};
+
+#endif
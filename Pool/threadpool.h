@@ -1,7 +1,10 @@
 #ifndef THREADPOOL_H
 #define THREADPOOL_H
 #include "nocopy.h"
+#include "topology.h"
+#include "probes.h"
 #include <condition_variable>
+#include <cstdint>
 #include <future>
 #include <memory>
 #include <mutex>
@@ -27,6 +30,24 @@ public:
         return thread_num_;
     }
 
+    // 排队等待执行的任务数
+    std::size_t QueueSize(){
+        std::lock_guard<std::mutex> lck(mtx_);
+        return tasks_.size();
+    }
+
+    // 按顺序把工作线程绑定到cpus上，线程比CPU多时轮流使用，返回每个线程绑定的CPU，绑定失败为-1
+    std::vector<int> SetAffinity(const std::vector<int>& cpus){
+        std::vector<int> assigned;
+        if(cpus.empty())
+            return assigned;
+        for(std::size_t i = 0; i < pool_.size(); ++i){
+            int cpu = cpus[i % cpus.size()];
+            assigned.push_back(Topology::PinThread(pool_[i].native_handle(), cpu) ? cpu : -1);
+        }
+        return assigned;
+    }
+
     template<class F, class ...Args>
     auto commit(F&& f, Args&& ...args) -> std::future<decltype(f(args...))> {
         using RetType = decltype(f(args...));
@@ -40,6 +61,8 @@ public:
         {
             std::lock_guard<std::mutex> lck(mtx_);
             tasks_.emplace([task]{(*task)();});
+            TW_PROBE2(pool__enqueue, enqueue_seq_, tasks_.size());
+            enqueue_seq_++;
         }
     
         cv_lock_.notify_one();
@@ -47,7 +70,7 @@ public:
     }
 
 private:
-    ThreadPool(unsigned int num = std::thread::hardware_concurrency()){
+    ThreadPool(unsigned int num = std::thread::hardware_concurrency()) : enqueue_seq_(0), dequeue_seq_(0){
         if(num == 1)
             thread_num_ = 2;
         else 
@@ -82,6 +105,8 @@ private:
 
                         task = std::move(this->tasks_.front());
                         this->tasks_.pop();
+                        TW_PROBE2(pool__dequeue, dequeue_seq_, tasks_.size());
+                        dequeue_seq_++;
                     }
                     thread_num_--;
                     task();
@@ -97,6 +122,8 @@ private:
     std::atomic_bool stop_;
     std::condition_variable cv_lock_;
     std::queue<Task> tasks_;
+    uint64_t enqueue_seq_;          // 队列先进先出，第n个出队的任务就是第n个入队的，探针用序号关联同一个任务
+    uint64_t dequeue_seq_;
     std::vector<std::thread> pool_;
 };
 
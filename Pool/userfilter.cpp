@@ -0,0 +1,207 @@
+#include "userfilter.h"
+#include "sqlconnpool.h"
+#include "registerbuffer.h"
+#include "../Log/log.h"
+#include "mysql.h"
+#include <algorithm>
+#include <cassert>
+#include <cctype>
+#include <chrono>
+#include <mutex>
+
+constexpr int FILTER_HASH_NUM = 7;              // 每个元素10个计数器、7个哈希函数，理论误判率约1%
+constexpr int FILTER_COUNTER_PER_USER = 10;
+
+UserFilter::UserFilter() :
+    capacity_(0),
+    rebuild_ms_(0),
+    is_open_(false),
+    filter_(nullptr),
+    is_rebuilding_(false),
+    rebuild_thread_(nullptr),
+    skip_count_(0),
+    false_positive_count_(0)
+{
+
+}
+
+UserFilter::~UserFilter(){
+    Close();
+}
+
+UserFilter& UserFilter::Instance(){
+    static UserFilter ins;
+    return ins;
+}
+
+// 启动时同步加载一次，加载失败则不启用过滤器，所有查询照常走数据库
+bool UserFilter::Init(int capacity, int rebuild_ms){
+    assert(capacity > 0);
+    if(is_open_.load())
+        return true;
+
+    capacity_ = capacity;
+    rebuild_ms_ = rebuild_ms;
+    if(!Rebuild()){
+        LOG_WARN("UserFilter load error, filter disabled");
+        return false;
+    }
+
+    is_open_.store(true);
+    if(rebuild_ms_ > 0){
+        rebuild_thread_.reset(new std::thread(&UserFilter::RebuildThread, this));
+    }
+    return true;
+}
+
+void UserFilter::Close(){
+    {
+        std::lock_guard<std::mutex> lck(mtx_);
+        if(!is_open_.exchange(false))
+            return;
+    }
+
+    cv_close_.notify_all();
+    if(rebuild_thread_ && rebuild_thread_->joinable()){
+        rebuild_thread_->join();
+    }
+    rebuild_thread_.reset();
+}
+
+bool UserFilter::IsOpen(){
+    return is_open_.load();
+}
+
+// 返回false时用户名一定没有注册过
+bool UserFilter::MayExist(const std::string& name){
+    if(!is_open_.load())
+        return true;
+
+    std::string key = Key(name);
+    std::lock_guard<std::mutex> lck(mtx_);
+    if(!filter_ || filter_->MayContain(key))
+        return true;
+
+    skip_count_++;
+    return false;
+}
+
+void UserFilter::Add(const std::string& name){
+    if(!is_open_.load())
+        return;
+
+    std::string key = Key(name);
+    std::lock_guard<std::mutex> lck(mtx_);
+    filter_->Add(key);
+    if(is_rebuilding_)
+        rebuild_adds_.push_back(key);
+}
+
+// 过滤器判定存在，但是数据库中没有查到
+void UserFilter::ReportFalsePositive(){
+    if(is_open_.load())
+        false_positive_count_++;
+}
+
+void UserFilter::RebuildThread(){
+    while(true){
+        {
+            std::unique_lock<std::mutex> lck(mtx_);
+            cv_close_.wait_for(lck, std::chrono::milliseconds(rebuild_ms_), [this](){
+                return !is_open_.load();
+            });
+            if(!is_open_.load())
+                break;
+        }
+        Rebuild();
+    }
+}
+
+// 从user表重新构建过滤器。先开始记录新注册的用户，再取写回缓冲中未落库的用户，最后读表，保证换上去的过滤器不会漏掉用户
+bool UserFilter::Rebuild(){
+    {
+        std::lock_guard<std::mutex> lck(mtx_);
+        is_rebuilding_ = true;
+        rebuild_adds_.clear();
+    }
+
+    std::vector<std::string> names;
+    RegisterBuffer::Instance().GetNames(&names);
+
+    auto start = std::chrono::steady_clock::now();
+    MYSQL* sql = SqlConnPool::Instance().GetConn();
+    bool ok = (sql != nullptr);
+    if(ok){
+        if(mysql_query(sql, "SELECT username FROM user")){
+            LOG_ERROR("UserFilter load error: %s", mysql_error(sql));
+            ok = false;
+        }else{
+            MYSQL_RES* res = mysql_use_result(sql);         // 逐行读取，不把整个结果集缓存在客户端
+            while(MYSQL_ROW row = mysql_fetch_row(res)){
+                names.emplace_back(row[0]);
+            }
+            mysql_free_result(res);
+        }
+        SqlConnPool::Instance().FreeConn(sql);
+    }
+
+    if(!ok){
+        std::lock_guard<std::mutex> lck(mtx_);
+        is_rebuilding_ = false;
+        rebuild_adds_.clear();
+        return false;
+    }
+
+    // 预留一倍的增长空间，用户数超过预期容量时跟着扩大
+    std::size_t expect = std::max((std::size_t)capacity_, names.size() * 2);
+    std::unique_ptr<CountingBloomFilter> filter(
+        new CountingBloomFilter(expect * FILTER_COUNTER_PER_USER, FILTER_HASH_NUM));
+    for(const auto& name : names){
+        filter->Add(Key(name));
+    }
+
+    std::lock_guard<std::mutex> lck(mtx_);
+    for(const auto& name : rebuild_adds_){
+        filter->Add(name);
+    }
+    filter_.swap(filter);
+    is_rebuilding_ = false;
+    rebuild_adds_.clear();
+
+    long long ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                        std::chrono::steady_clock::now() - start).count();
+    LOG_INFO("UserFilter rebuild users: %d, counters: %d, cost: %lldms, estimate fpr: %.4f, observed fpr: %.4f",
+            (int)filter_->Size(), (int)filter_->CounterNum(), ms, filter_->EstimateFpr(), GetFalsePositiveRate());
+    return true;
+}
+
+// 和数据库的比较方式一致："Alice"和"alice "在库里是同一个用户名。
+// 只处理ASCII，非ASCII字符的大小写和重音由数据库判断，过滤器可能多判定存在，不会漏判
+std::string UserFilter::Key(const std::string& name){
+    std::string key = name;
+    key.erase(key.find_last_not_of(' ') + 1);
+    for(auto& c : key){
+        c = std::tolower((unsigned char)c);
+    }
+    return key;
+}
+
+uint64_t UserFilter::GetSkipCount() const{
+    return skip_count_.load();
+}
+
+uint64_t UserFilter::GetFalsePositiveCount() const{
+    return false_positive_count_.load();
+}
+
+// 实际误判率：误判次数 / (误判次数 + 正确判定不存在的次数)
+double UserFilter::GetFalsePositiveRate() const{
+    uint64_t fp = false_positive_count_.load();
+    uint64_t negative = fp + skip_count_.load();
+    return negative == 0 ? 0.0 : (double)fp / (double)negative;
+}
+
+double UserFilter::GetEstimateFpr(){
+    std::lock_guard<std::mutex> lck(mtx_);
+    return filter_ ? filter_->EstimateFpr() : 0.0;
+}
@@ -0,0 +1,54 @@
+#ifndef USERFILTER_H
+#define USERFILTER_H
+#include "nocopy.h"
+#include "bloomfilter.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// 已注册用户名的布隆过滤器，启动时从user表加载，注册时更新，后台线程定期重建。判定不存在的用户名不用再查数据库。
+// user表默认的排序规则不区分大小写、忽略末尾空格，过滤器的键按同样的规则归一化
+class UserFilter : public NoCopy{
+public:
+    static UserFilter& Instance();
+
+    bool Init(int capacity, int rebuild_ms);
+    void Close();
+    bool IsOpen();
+    bool MayExist(const std::string& name);
+    void Add(const std::string& name);
+    void ReportFalsePositive();
+
+    uint64_t GetSkipCount() const;
+    uint64_t GetFalsePositiveCount() const;
+    double GetFalsePositiveRate() const;
+    double GetEstimateFpr();
+
+private:
+    UserFilter();
+    ~UserFilter();
+    bool Rebuild();
+    void RebuildThread();
+    static std::string Key(const std::string& name);
+
+private:
+    int capacity_;
+    int rebuild_ms_;
+    std::atomic_bool is_open_;
+    std::mutex mtx_;
+    std::condition_variable cv_close_;
+    std::unique_ptr<CountingBloomFilter> filter_;
+    bool is_rebuilding_;
+    std::vector<std::string> rebuild_adds_;         // 重建期间新注册的用户，换上新过滤器前补进去
+    std::unique_ptr<std::thread> rebuild_thread_;
+
+    std::atomic<uint64_t> skip_count_;              // 判定不存在，跳过数据库的次数
+    std::atomic<uint64_t> false_positive_count_;    // 判定存在但数据库中没有的次数
+};
+
+#endif
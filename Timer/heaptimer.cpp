@@ -4,6 +4,8 @@
 #include <chrono>
 #include <cstddef>
 #include <utility>
+#include "../Metrics/metrics.h"
+#include "probes.h"
 
 HeapTimer::HeapTimer() {
     heap_.reserve(64);
@@ -29,14 +31,13 @@ void HeapTimer::SwapNode(size_t i, size_t j){
 // 元素上浮，给与一个节点的索引，如果这个节点的父节点值比这个元素的值大，就把这个元素和父节点位置交换，也就是对给定节点上浮
 void HeapTimer::SiftUp(size_t i){
     assert(i >= 0 && i < heap_.size());
-    size_t parent = (i -1) / 2; //求出这个节点的父节点
-    while(1){           // 不断上浮，直到这个元素的父节点小于等于这个元素
+    while(i > 0){           // 不断上浮，直到到达堆顶或者这个元素的父节点小于等于这个元素
+        size_t parent = (i - 1) / 2;        //求出这个节点的父节点
         if(heap_[parent] > heap_[i]){
             SwapNode(i, parent);
             i = parent;
-            parent = (i - 1) /2;
         }else{
-            break;;
+            break;
         }
     }
 }
@@ -94,8 +95,8 @@ void HeapTimer::Del(size_t index){
     heap_.pop_back();
 }
 
+// id一般是socket，负数的id留给服务器内部的定时任务
 void HeapTimer::Add(int id, int time_out, const TimeoutCallBack& call_back_func){
-    assert(id >= 0);
 
     if(ref_.count(id) == 1){        // 如果这个元素存在了，就调整
         int temp = ref_[id];
@@ -120,8 +121,8 @@ void HeapTimer::DoWork(int id){
 
     size_t i = ref_[id];
     auto node = heap_[i];
+    Del(i);             // 先删除节点再执行回调，回调中可以重新添加同一个id
     node.call_back_function();
-    Del(i);
 }
 
 // 处理超时事件
@@ -135,8 +136,10 @@ void HeapTimer::Tick(){
             break;      // 如果不是，就说明堆中的应该超时处理的节点已经被处理掉了
         }
 
-        node.call_back_function();
         Pop();
+        Metrics::Add(MC_TIMER_EXPIRE);
+        TW_PROBE1(timer__fire, node.id);
+        node.call_back_function();
     }
 }
 
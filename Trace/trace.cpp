@@ -0,0 +1,146 @@
+#include "trace.h"
+#include <cstdio>
+#include <fstream>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <unordered_set>
+
+bool Trace::is_open_ = false;
+
+static const char* PHASE_NAMES[TP_PHASE_NUM] = {
+    "accept", "queue", "read", "parse", "sql_queue", "verify", "response", "write", "request",
+};
+
+Trace::Trace() :
+    sample_n_(0),
+    slow_us_(0),
+    thread_seq_(0)
+{
+
+}
+
+Trace& Trace::Instance(){
+    static Trace ins;
+    return ins;
+}
+
+void Trace::Init(int sample_n, int slow_ms){
+    sample_n_ = sample_n;
+    slow_us_ = (int64_t)slow_ms * 1000;
+    is_open_ = true;
+}
+
+TraceRing* Trace::Ring(){
+    static thread_local TraceRing* ring = nullptr;
+    if(!ring)
+        ring = Instance().NewRing();
+    return ring;
+}
+
+TraceRing* Trace::NewRing(){
+    TraceRing* ring = new TraceRing();          // 值初始化，全部为0
+    ring->tid = (int)syscall(SYS_gettid);
+    std::lock_guard<std::mutex> lck(mtx_);
+    rings_.push_back(ring);
+    return ring;
+}
+
+// 高位是线程序号，低40位是线程内的请求序号，不需要原子操作
+uint64_t Trace::NewId(){
+    static thread_local uint64_t next = 0;
+    if(next == 0)
+        next = ((uint64_t)Instance().thread_seq_.fetch_add(1) + 1) << 40;
+    return next++;
+}
+
+void Trace::Record(uint64_t id, TRACE_PHASE phase, int64_t start_us, int64_t end_us, uint16_t flags){
+    TraceRing* ring = Ring();
+    uint64_t n = ring->head.load(std::memory_order_relaxed);
+    TraceSlot& slot = ring->slots[n & (TRACE_RING_SIZE - 1)];
+
+    uint64_t dur = end_us > start_us ? end_us - start_us : 0;
+    if(dur > UINT32_MAX)
+        dur = UINT32_MAX;
+
+    slot.seq.store(2 * n + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.id.store(id, std::memory_order_relaxed);
+    slot.start_us.store(start_us, std::memory_order_relaxed);
+    slot.info.store(dur << 32 | (uint64_t)phase << 16 | flags, std::memory_order_relaxed);
+    slot.seq.store(2 * n + 2, std::memory_order_release);
+    ring->head.store(n + 1, std::memory_order_release);
+}
+
+// 请求结束，记录整个请求并决定是否保留
+void Trace::Finish(uint64_t id, int64_t start_us, int64_t end_us){
+    Trace& trace = Instance();
+    bool keep = (trace.sample_n_ > 0 && id % trace.sample_n_ == 0) ||
+                (trace.slow_us_ > 0 && end_us - start_us >= trace.slow_us_);
+    Record(id, TP_REQUEST, start_us, end_us, keep ? TRACE_KEEP : 0);
+}
+
+// 复制所有线程的环形缓冲区，正在被覆盖的槽位跳过
+void Trace::Snapshot(std::vector<Span>& spans){
+    std::lock_guard<std::mutex> lck(mtx_);
+    for(TraceRing* ring : rings_){
+        uint64_t head = ring->head.load(std::memory_order_acquire);
+        uint64_t begin = head > TRACE_RING_SIZE ? head - TRACE_RING_SIZE : 0;
+        for(uint64_t n = begin; n < head; ++n){
+            const TraceSlot& slot = ring->slots[n & (TRACE_RING_SIZE - 1)];
+            uint64_t seq = slot.seq.load(std::memory_order_acquire);
+            if(seq != 2 * n + 2)
+                continue;
+
+            Span span;
+            span.tid = ring->tid;
+            span.id = slot.id.load(std::memory_order_relaxed);
+            span.start_us = slot.start_us.load(std::memory_order_relaxed);
+            uint64_t info = slot.info.load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if(slot.seq.load(std::memory_order_relaxed) != seq)
+                continue;
+
+            span.dur_us = (uint32_t)(info >> 32);
+            span.phase = (uint16_t)(info >> 16);
+            span.flags = (uint16_t)info;
+            spans.push_back(span);
+        }
+    }
+}
+
+// 导出保留的请求，格式为Chrome trace_event，可以直接用Perfetto或者chrome://tracing打开
+std::string Trace::Dump(){
+    std::vector<Span> spans;
+    Snapshot(spans);
+
+    std::unordered_set<uint64_t> kept;
+    for(const Span& span : spans){
+        if(span.phase == TP_REQUEST && (span.flags & TRACE_KEEP))
+            kept.insert(span.id);
+    }
+
+    std::string out = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    char line[256];
+    int pid = getpid();
+    bool first = true;
+    for(const Span& span : spans){
+        if(!kept.count(span.id) || span.phase >= TP_PHASE_NUM)
+            continue;
+        snprintf(line, sizeof(line), "%s\n{\"name\":\"%s\",\"cat\":\"http\",\"ph\":\"X\",\"pid\":%d,\"tid\":%d,"
+                "\"ts\":%lld,\"dur\":%u,\"args\":{\"request\":\"%llx\"}}",
+                first ? "" : ",", PHASE_NAMES[span.phase], pid, span.tid,
+                (long long)span.start_us, span.dur_us, (unsigned long long)span.id);
+        out += line;
+        first = false;
+    }
+    out += "\n]}\n";
+    return out;
+}
+
+bool Trace::DumpFile(const std::string& file){
+    std::ofstream out(file);
+    if(!out)
+        return false;
+    out << Dump();
+    return (bool)out;
+}
@@ -0,0 +1,95 @@
+#ifndef TRACE_H
+#define TRACE_H
+#include "nocopy.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+constexpr const char* TRACE_PATH = "/debug/trace";      // 保留路径，开启追踪后返回Chrome trace_event格式的JSON
+constexpr int TRACE_RING_BITS = 13;
+constexpr uint32_t TRACE_RING_SIZE = 1u << TRACE_RING_BITS;     // 每个线程保留最近8192段
+
+// 请求经过的阶段
+enum TRACE_PHASE{
+    TP_ACCEPT = 0,          // accept4以及注册连接
+    TP_QUEUE,               // 在线程池队列中等待
+    TP_READ,                // 读socket
+    TP_PARSE,               // 解析请求
+    TP_SQL_QUEUE,           // 等待数据库线程
+    TP_VERIFY,              // 查询数据库校验用户
+    TP_RESPONSE,            // 生成响应
+    TP_WRITE,               // writev
+    TP_REQUEST,             // 整个请求，从收到第一个字节到响应写完
+    TP_PHASE_NUM
+};
+
+constexpr uint16_t TRACE_KEEP = 1;          // 请求被采样或者是慢请求，导出时保留它的所有阶段
+
+// 环形缓冲区中的一段。每个槽位带序号，写入前为奇数，写完为偶数，读的时候前后序号一致才算有效
+struct TraceSlot{
+    std::atomic<uint64_t> seq;
+    std::atomic<uint64_t> id;
+    std::atomic<int64_t> start_us;
+    std::atomic<uint64_t> info;             // 持续时间(高32位) | 阶段(16位) | 标志(16位)
+};
+
+// 一个线程的环形缓冲区，只有所属线程写，满了覆盖最旧的
+struct TraceRing{
+    int tid;
+    std::atomic<uint64_t> head;
+    TraceSlot slots[TRACE_RING_SIZE];
+};
+
+// 请求阶段追踪。每个阶段的起止时间写进所属线程的环形缓冲区，不加锁；
+// 请求结束时按采样率或者慢请求阈值决定是否保留，导出时只输出保留的请求
+class Trace : public NoCopy{
+public:
+    static Trace& Instance();
+
+    void Init(int sample_n, int slow_ms);
+    static bool IsOpen(){
+        return is_open_;
+    }
+
+    static int64_t NowUs(){
+        return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    static uint64_t NewId();
+    static void Record(uint64_t id, TRACE_PHASE phase, int64_t start_us, int64_t end_us, uint16_t flags = 0);
+    static void Finish(uint64_t id, int64_t start_us, int64_t end_us);
+
+    std::string Dump();
+    bool DumpFile(const std::string& file);
+
+private:
+    struct Span{
+        int tid;
+        uint64_t id;
+        int64_t start_us;
+        uint32_t dur_us;
+        uint16_t phase;
+        uint16_t flags;
+    };
+
+private:
+    Trace();
+    ~Trace() = default;
+    static TraceRing* Ring();
+    TraceRing* NewRing();
+    void Snapshot(std::vector<Span>& spans);
+
+private:
+    static bool is_open_;
+    int sample_n_;                  // 每多少个请求采样一个，0为不采样
+    int64_t slow_us_;               // 超过这个时间的请求都保留，0为不按时间保留
+    std::atomic<uint32_t> thread_seq_;
+
+    std::mutex mtx_;
+    std::vector<TraceRing*> rings_;
+};
+
+#endif
@@ -0,0 +1,45 @@
+#!/bin/sh
+# 对比epoll和io_uring两种I/O后端：每秒请求数和每个请求的系统调用次数
+# 用法: bench/backend_compare.sh [秒数] [并发连接数] [路径]
+# 需要先编译好bin/TinyWebServer和bin/bench，并且1316端口空闲。
+# 用cmake -DACCOUNTING=ON编译的服务器会输出每个请求所有系统调用的次数，否则只有多路复用本身(epoll_wait/epoll_ctl或io_uring_enter)的次数
+
+DURATION=${1:-5}
+CONNS=${2:-20}
+URL_PATH=${3:-/index.html}
+BIN_DIR=$(cd "$(dirname "$0")/../bin" && pwd)
+
+run_backend(){
+    backend=$1
+    shift
+    cd "$BIN_DIR" || exit 1
+    rm -f log/*.log
+    ./TinyWebServer -b "$backend" "$@" > /dev/null 2> accounting.txt &
+    pid=$!
+    sleep 1
+
+    report=$(./bench -c "$CONNS" -d "$DURATION" -u "$URL_PATH" -N "$backend")
+    kill -INT $pid
+    wait $pid 2>/dev/null
+
+    requests=$(echo "$report" | grep '^requests:' | sed 's/requests: \([0-9]*\).*/\1/')
+    rps=$(echo "$report" | grep '^requests:' | sed 's/.*(\([0-9.]*\)\/s).*/\1/')
+    name=$(grep -h "IO Backend: .*syscalls" log/*.log | tail -n 1 | sed 's/.*IO Backend: \([^,]*\),.*/\1/')
+    poller=$(grep -h "IO Backend: .*syscalls" log/*.log | tail -n 1 | sed 's/.*syscalls: //')
+    if grep -q "Syscall accounting" accounting.txt; then
+        per_request=$(grep "Syscall accounting" accounting.txt | sed 's/.*syscalls \([0-9.]*\),.*/\1/')
+        # 完成模式下读写都在环里，按阶段列出剩下的系统调用
+        printf '%-10s requests=%s rps=%s syscalls_per_request=%s\n' "$backend" "$requests" "$rps" "$per_request"
+        sed -n '2,$p' accounting.txt | sed 's/ new [0-9.]*.*//' | grep -v ':$' | sed 's/^/           /'
+    else
+        per_req_x100=$((poller * 100 / requests))
+        printf '%-10s requests=%s rps=%s poller_syscalls_per_request=%d.%02d\n' \
+            "$backend" "$requests" "$rps" $((per_req_x100 / 100)) $((per_req_x100 % 100))
+    fi
+    echo "           backend: $name"
+    rm -f accounting.txt
+}
+
+# io_uring完成模式在事件循环线程处理请求并开启文件缓存，epoll用-i做同样的配置
+run_backend epoll -i
+run_backend uring
@@ -0,0 +1,39 @@
+#!/bin/sh
+# 对比TCP参数调优开关前后的首字节延迟(curl的time_starttransfer)，每个请求都是新连接
+# 用法: bench/first_byte.sh [请求数] [路径]
+# 需要先编译好bin/TinyWebServer，并且1316端口空闲
+
+REQUESTS=${1:-500}
+URL_PATH=${2:-/index.html}
+URL="http://127.0.0.1:1316${URL_PATH}"
+BIN_DIR=$(cd "$(dirname "$0")/../bin" && pwd)
+
+run_profile(){
+    name=$1
+    shift
+    cd "$BIN_DIR" || exit 1
+    ./TinyWebServer "$@" > /dev/null 2>&1 &
+    pid=$!
+    sleep 1
+
+    # 每个URL都要单独指定-o，否则只有第一个响应会被丢弃
+    urls=$(i=0; while [ $i -lt "$REQUESTS" ]; do printf -- '-o /dev/null %s ' "$URL"; i=$((i + 1)); done)
+    # Connection: close让服务器在响应后关闭连接，curl对每个URL重新建立连接
+    curl -s -H "Connection: close" -w '%{time_starttransfer}\n' $urls > /tmp/first_byte_$$.txt
+
+    kill -INT $pid
+    wait $pid 2>/dev/null
+
+    sort -n /tmp/first_byte_$$.txt | awk -v name="$name" '
+        { v[NR] = $1 * 1000000; sum += v[NR] }
+        END {
+            if (NR == 0) { printf "%-4s no samples\n", name; exit }
+            p50 = v[int(NR * 0.50) > 0 ? int(NR * 0.50) : 1]
+            p99 = v[int(NR * 0.99) > 0 ? int(NR * 0.99) : 1]
+            printf "%-4s requests=%d avg_us=%d p50_us=%d p99_us=%d max_us=%d\n", name, NR, sum / NR, p50, p99, v[NR]
+        }'
+    rm -f /tmp/first_byte_$$.txt
+}
+
+run_profile off
+run_profile on -t
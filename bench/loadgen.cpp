@@ -0,0 +1,650 @@
+// HTTP/1.1压测工具，每个线程一个epoll，管理自己的一组连接。
+// 闭环模式下每条连接保持depth个请求在途；开环模式按固定速率计划请求，延迟从计划发送的时间算起，
+// 服务器变慢时排队的时间也计入延迟，避免协调遗漏(coordinated omission)让结果偏乐观
+#include <algorithm>
+#include <arpa/inet.h>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fcntl.h>
+#include <map>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <signal.h>
+#include <string>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <thread>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+#include "perfcounter.h"
+
+constexpr std::size_t MAX_HEAD = 64 * 1024;         // 响应头超过这个长度认为是协议错误
+constexpr int MAX_EVENTS = 1024;
+
+struct LoadOptions{
+    std::string host = "127.0.0.1";
+    int port = 1316;
+    int threads = 1;
+    int connections = 10;           // 所有线程的连接总数
+    int duration_s = 10;
+    int depth = 1;                  // 流水线深度，每条连接最多同时在途的请求数
+    int requests_per_conn = 0;      // 每条连接完成多少个请求后关闭重连，0为一直保持
+    double rate = 0;                // 开环模式的总请求速率(每秒)，0为闭环
+    int timeout_ms = 5000;          // 请求超过这个时间没有进展就算超时并重连
+    std::string method = "GET";
+    std::string path = "/";
+    std::string body;
+    std::string name;               // 场景名，只用于输出
+    bool json = false;              // 额外输出一行JSON
+    pid_t server_pid = 0;           // 统计这个进程在压测期间的硬件计数器，0为不统计
+};
+
+static int64_t NowNs(){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+// 对数线性直方图，单位微秒，每个2的幂区间分成128个桶，相对误差小于1%
+class Histogram{
+public:
+    Histogram() : counts_(BUCKET_NUM, 0), total_(0), sum_(0), min_(UINT64_MAX), max_(0) {}
+
+    void Record(uint64_t us){
+        counts_[Index(us)]++;
+        total_++;
+        sum_ += us;
+        min_ = std::min(min_, us);
+        max_ = std::max(max_, us);
+    }
+
+    void Merge(const Histogram& other){
+        for(int i = 0; i < BUCKET_NUM; ++i)
+            counts_[i] += other.counts_[i];
+        total_ += other.total_;
+        sum_ += other.sum_;
+        min_ = std::min(min_, other.min_);
+        max_ = std::max(max_, other.max_);
+    }
+
+    // 返回第p百分位所在桶的上界，不超过实际最大值
+    uint64_t Percentile(double p) const{
+        if(total_ == 0)
+            return 0;
+        uint64_t rank = (uint64_t)(p / 100.0 * total_ + 0.5);
+        rank = std::max<uint64_t>(rank, 1);
+        uint64_t count = 0;
+        for(int i = 0; i < BUCKET_NUM; ++i){
+            count += counts_[i];
+            if(count >= rank)
+                return std::min(Upper(i), max_);
+        }
+        return max_;
+    }
+
+    uint64_t Total() const { return total_; }
+    uint64_t Min() const { return total_ ? min_ : 0; }
+    uint64_t Max() const { return max_; }
+    double Mean() const { return total_ ? (double)sum_ / total_ : 0; }
+
+private:
+    static const int SUB_BITS = 7;
+    static const int SUB_NUM = 1 << SUB_BITS;
+    static const int MAX_EXP = 40;
+    static const int BUCKET_NUM = (MAX_EXP - SUB_BITS + 2) * SUB_NUM;
+
+    static int Index(uint64_t us){
+        if(us < SUB_NUM)
+            return (int)us;
+        int exp = 63 - __builtin_clzll(us);
+        if(exp > MAX_EXP)
+            return BUCKET_NUM - 1;
+        return (exp - SUB_BITS + 1) * SUB_NUM + (int)((us >> (exp - SUB_BITS)) & (SUB_NUM - 1));
+    }
+
+    static uint64_t Upper(int index){
+        if(index < SUB_NUM)
+            return index;
+        int exp = index / SUB_NUM + SUB_BITS - 1;
+        uint64_t lower = (uint64_t)(SUB_NUM + index % SUB_NUM) << (exp - SUB_BITS);
+        return lower + (1ull << (exp - SUB_BITS)) - 1;
+    }
+
+private:
+    std::vector<uint64_t> counts_;
+    uint64_t total_;
+    uint64_t sum_;
+    uint64_t min_;
+    uint64_t max_;
+};
+
+struct LoadStats{
+    uint64_t completed = 0;
+    uint64_t bytes = 0;             // 收到的字节数，包括响应头
+    uint64_t connects = 0;
+    uint64_t connect_errors = 0;
+    uint64_t read_errors = 0;       // 有请求在途时连接被关闭或者出错，每个在途请求算一次
+    uint64_t timeouts = 0;
+    uint64_t parse_errors = 0;
+    uint64_t unfinished = 0;        // 结束时还在途或者还没发出的请求
+    std::map<int, uint64_t> status;
+    Histogram latency;
+
+    void Merge(const LoadStats& other){
+        completed += other.completed;
+        bytes += other.bytes;
+        connects += other.connects;
+        connect_errors += other.connect_errors;
+        read_errors += other.read_errors;
+        timeouts += other.timeouts;
+        parse_errors += other.parse_errors;
+        unfinished += other.unfinished;
+        for(auto& item : other.status)
+            status[item.first] += item.second;
+        latency.Merge(other.latency);
+    }
+};
+
+struct LoadConn{
+    int fd = -1;
+    bool connected = false;
+    std::string out;                    // 还没写出的请求
+    std::size_t out_pos = 0;
+    std::deque<int64_t> inflight;       // 在途请求的开始时间，开环模式为计划时间
+    int sent = 0;                       // 这条连接发出的请求数
+    int done = 0;                       // 这条连接完成的请求数
+    std::string head;                   // 还没收完的响应头
+    int64_t body_left = 0;              // 当前响应还没收到的响应体长度
+    int status = 0;
+    bool server_close = false;          // 服务器在响应中要求关闭连接
+    int64_t progress_ns = 0;            // 上次收发数据的时间
+};
+
+class LoadWorker{
+public:
+    LoadWorker(const LoadOptions& opt, int conn_num, double rate, const sockaddr_in& addr) :
+        opt_(opt), conns_(conn_num), rate_(rate), interval_ns_(rate > 0 ? std::max(1.0, 1e9 / rate) : 0),
+        addr_(addr), epfd_(-1), start_ns_(0), next_due_ns_(0) {}
+
+    void Run(int64_t end_ns);
+    const LoadStats& Stats() const { return stats_; }
+
+private:
+    void Connect(LoadConn& c);
+    void Close(LoadConn& c);
+    void Reconnect(LoadConn& c);
+    void OnEvent(LoadConn& c, uint32_t events);
+    bool Feed(LoadConn& c, const char* data, std::size_t len);
+    bool ParseHead(LoadConn& c, std::size_t end);
+    void Complete(LoadConn& c);
+    void Send(LoadConn& c, int64_t start_ns);
+    void Flush(LoadConn& c);
+    void Fill(LoadConn& c);
+    void Dispatch();
+    void CheckTimeout(int64_t now);
+    bool CanSend(const LoadConn& c) const;
+
+private:
+    const LoadOptions& opt_;
+    std::vector<LoadConn> conns_;
+    double rate_;                       // 这个线程的开环速率
+    double interval_ns_;                // 开环模式两个请求的计划间隔，保留小数，至少1ns
+    sockaddr_in addr_;
+    int epfd_;
+    std::string request_;
+    int64_t start_ns_;                  // 开环模式开始计划的时间
+    int64_t next_due_ns_;               // 开环模式下一个请求的计划时间
+    uint64_t scheduled_ = 0;            // 已经到期的请求数，计划时间按序号从start_ns_算，间隔的小数部分不会累积丢失
+    std::deque<int64_t> backlog_;       // 到了计划时间但是没有空闲连接的请求
+    std::size_t next_conn_ = 0;
+    LoadStats stats_;
+};
+
+void LoadWorker::Connect(LoadConn& c){
+    c = LoadConn();
+    c.fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if(c.fd < 0){
+        stats_.connect_errors++;
+        return;
+    }
+    int opt = 1;
+    setsockopt(c.fd, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt));
+    c.progress_ns = NowNs();
+    stats_.connects++;
+
+    int ret = connect(c.fd, (const sockaddr*)&addr_, sizeof(addr_));
+    if(ret < 0 && errno != EINPROGRESS){
+        stats_.connect_errors++;
+        close(c.fd);
+        c.fd = -1;
+        return;
+    }
+
+    struct epoll_event ev{};
+    ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+    ev.data.ptr = &c;
+    epoll_ctl(epfd_, EPOLL_CTL_ADD, c.fd, &ev);
+}
+
+void LoadWorker::Close(LoadConn& c){
+    if(c.fd >= 0){
+        close(c.fd);
+        c.fd = -1;
+    }
+    c.connected = false;
+}
+
+// 连接断开时在途的请求算作失败，开环模式下还没发出去的请求留在backlog_里，不会丢
+void LoadWorker::Reconnect(LoadConn& c){
+    Close(c);
+    Connect(c);
+}
+
+bool LoadWorker::CanSend(const LoadConn& c) const{
+    return c.connected && (int)c.inflight.size() < opt_.depth &&
+        (opt_.requests_per_conn <= 0 || c.sent < opt_.requests_per_conn);
+}
+
+void LoadWorker::Send(LoadConn& c, int64_t start_ns){
+    c.out.append(request_);
+    c.inflight.push_back(start_ns);
+    c.sent++;
+}
+
+// 写到EAGAIN，没写完的等EPOLLOUT
+void LoadWorker::Flush(LoadConn& c){
+    while(c.out_pos < c.out.size()){
+        ssize_t len = write(c.fd, c.out.data() + c.out_pos, c.out.size() - c.out_pos);
+        if(len <= 0)
+            break;
+        c.out_pos += len;
+        c.progress_ns = NowNs();
+    }
+    if(c.out_pos == c.out.size()){
+        c.out.clear();
+        c.out_pos = 0;
+    }
+}
+
+// 闭环模式把连接的在途请求补满
+void LoadWorker::Fill(LoadConn& c){
+    if(rate_ > 0)
+        return;
+    bool sent = false;
+    while(CanSend(c)){
+        Send(c, NowNs());
+        sent = true;
+    }
+    if(sent)
+        Flush(c);
+}
+
+// 开环模式把到期的请求分给有空位的连接，轮流分配
+void LoadWorker::Dispatch(){
+    int64_t now = NowNs();
+    while(next_due_ns_ <= now){
+        backlog_.push_back(next_due_ns_);
+        scheduled_++;
+        next_due_ns_ = start_ns_ + (int64_t)(scheduled_ * interval_ns_);
+    }
+
+    for(std::size_t tried = 0; !backlog_.empty() && tried < conns_.size(); ){
+        LoadConn& c = conns_[next_conn_];
+        if(CanSend(c)){
+            Send(c, backlog_.front());
+            backlog_.pop_front();
+            Flush(c);
+            tried = 0;
+            if((int)c.inflight.size() < opt_.depth)
+                continue;
+        }else{
+            tried++;
+        }
+        next_conn_ = (next_conn_ + 1) % conns_.size();
+    }
+}
+
+bool LoadWorker::ParseHead(LoadConn& c, std::size_t end){
+    if(c.head.compare(0, 5, "HTTP/") != 0)
+        return false;
+    std::size_t space = c.head.find(' ');
+    if(space == std::string::npos || space > end)
+        return false;
+    c.status = atoi(c.head.c_str() + space + 1);
+    c.body_left = 0;
+    c.server_close = false;
+
+    // 逐行找Content-Length和Connection，头部名称不区分大小写
+    std::size_t pos = c.head.find("\r\n") + 2;
+    while(pos < end){
+        std::size_t line_end = c.head.find("\r\n", pos);
+        std::string line = c.head.substr(pos, line_end - pos);
+        std::transform(line.begin(), line.end(), line.begin(), ::tolower);
+        if(line.compare(0, 15, "content-length:") == 0){
+            c.body_left = atoll(line.c_str() + 15);
+        }else if(line.compare(0, 11, "connection:") == 0 && line.find("close") != std::string::npos){
+            c.server_close = true;
+        }
+        pos = line_end + 2;
+    }
+    return c.body_left >= 0;
+}
+
+void LoadWorker::Complete(LoadConn& c){
+    int64_t now = NowNs();
+    stats_.latency.Record((uint64_t)(now - c.inflight.front()) / 1000);
+    stats_.status[c.status]++;
+    stats_.completed++;
+    c.inflight.pop_front();
+    c.done++;
+}
+
+// 处理收到的数据，可能包含多个响应，也可能只有半个。协议错误返回false
+bool LoadWorker::Feed(LoadConn& c, const char* data, std::size_t len){
+    std::string rest;
+    while(len > 0){
+        if(c.body_left > 0){
+            std::size_t n = std::min<std::size_t>(len, c.body_left);
+            c.body_left -= n;
+            data += n;
+            len -= n;
+            if(c.body_left == 0)
+                Complete(c);
+            continue;
+        }
+
+        c.head.append(data, len);
+        len = 0;
+        std::size_t end = c.head.find("\r\n\r\n");
+        if(end == std::string::npos)
+            return c.head.size() < MAX_HEAD;
+        if(c.inflight.empty() || !ParseHead(c, end))
+            return false;
+
+        rest.assign(c.head, end + 4, std::string::npos);        // 先拷贝再清空，data指向rest
+        c.head.clear();
+        data = rest.data();
+        len = rest.size();
+        if(c.body_left == 0)
+            Complete(c);
+    }
+    return true;
+}
+
+void LoadWorker::OnEvent(LoadConn& c, uint32_t events){
+    if(!c.connected && (events & (EPOLLOUT | EPOLLERR | EPOLLHUP))){
+        int err = 0;
+        socklen_t len = sizeof(err);
+        getsockopt(c.fd, SOL_SOCKET, SO_ERROR, &err, &len);
+        if(err != 0){
+            stats_.connect_errors++;
+            Reconnect(c);
+            return;
+        }
+        c.connected = true;
+        Fill(c);
+    }
+
+    if(events & EPOLLOUT){
+        Flush(c);
+    }
+
+    if(events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)){
+        char buf[65536];
+        bool closed = false;
+        while(true){
+            ssize_t len = read(c.fd, buf, sizeof(buf));
+            if(len > 0){
+                stats_.bytes += len;
+                c.progress_ns = NowNs();
+                if(!Feed(c, buf, len)){
+                    stats_.parse_errors++;
+                    stats_.read_errors += c.inflight.size();
+                    Reconnect(c);
+                    return;
+                }
+                continue;
+            }
+            if(len == 0 || (errno != EAGAIN && errno != EINTR))
+                closed = true;
+            if(len == 0 || errno != EINTR)
+                break;
+        }
+
+        // 服务器要求关闭，或者这条连接的请求数用完，重连
+        bool churn = opt_.requests_per_conn > 0 && c.done >= opt_.requests_per_conn;
+        if(closed || (c.inflight.empty() && (c.server_close || churn))){
+            stats_.read_errors += c.inflight.size();
+            Reconnect(c);
+            return;
+        }
+    }
+    Fill(c);
+}
+
+// 在途请求太久没有进展，可能是服务器丢了请求，算作超时并重连
+void LoadWorker::CheckTimeout(int64_t now){
+    for(LoadConn& c : conns_){
+        if(c.fd < 0){
+            Connect(c);
+            continue;
+        }
+        bool waiting = !c.inflight.empty() || !c.connected;
+        if(waiting && now - c.progress_ns > (int64_t)opt_.timeout_ms * 1000000){
+            if(c.connected)
+                stats_.timeouts += c.inflight.size();
+            else
+                stats_.connect_errors++;
+            Reconnect(c);
+        }
+    }
+}
+
+void LoadWorker::Run(int64_t end_ns){
+    request_ = opt_.method + " " + opt_.path + " HTTP/1.1\r\nHost: " + opt_.host + ":" + std::to_string(opt_.port) + "\r\n";
+    request_ += opt_.requests_per_conn == 1 ? "Connection: close\r\n" : "Connection: keep-alive\r\n";
+    if(!opt_.body.empty()){
+        request_ += "Content-Type: application/x-www-form-urlencoded\r\nContent-Length: " + std::to_string(opt_.body.size()) + "\r\n";
+    }
+    request_ += "\r\n" + opt_.body;
+
+    epfd_ = epoll_create1(EPOLL_CLOEXEC);
+    for(LoadConn& c : conns_)
+        Connect(c);
+
+    struct epoll_event events[MAX_EVENTS];
+    start_ns_ = next_due_ns_ = NowNs();
+    int64_t next_check = NowNs() + 100000000;
+    while(true){
+        int64_t now = NowNs();
+        if(now >= end_ns)
+            break;
+
+        int wait_ms = (int)std::min<int64_t>((end_ns - now) / 1000000 + 1, 100);
+        if(rate_ > 0){
+            Dispatch();
+            int64_t due_ms = (next_due_ns_ - NowNs()) / 1000000;
+            wait_ms = (int)std::max<int64_t>(0, std::min<int64_t>(wait_ms, due_ms));
+        }
+
+        int n = epoll_wait(epfd_, events, MAX_EVENTS, wait_ms);
+        for(int i = 0; i < n; ++i){
+            LoadConn* c = (LoadConn*)events[i].data.ptr;
+            if(c->fd >= 0)
+                OnEvent(*c, events[i].events);
+        }
+
+        now = NowNs();
+        if(now >= next_check){
+            CheckTimeout(now);
+            next_check = now + 100000000;
+        }
+    }
+
+    for(LoadConn& c : conns_){
+        stats_.unfinished += c.inflight.size();
+        Close(c);
+    }
+    stats_.unfinished += backlog_.size();
+    close(epfd_);
+}
+
+static void Usage(const char* prog){
+    fprintf(stderr,
+        "usage: %s [options]\n"
+        "  -H host       server address, default 127.0.0.1\n"
+        "  -p port       default 1316\n"
+        "  -t threads    default 1\n"
+        "  -c conns      total connections, default 10\n"
+        "  -d seconds    duration, default 10\n"
+        "  -D depth      pipelined requests in flight per connection, default 1\n"
+        "  -n requests   requests per connection before reconnecting, 0 keeps it open (default)\n"
+        "  -r rate       open loop at this many requests per second, 0 is closed loop (default)\n"
+        "  -T ms         request timeout, default 5000\n"
+        "  -m method     default GET\n"
+        "  -u path       default /\n"
+        "  -b body       request body, sent as a urlencoded form\n"
+        "  -N name       scenario name for the report\n"
+        "  -j            also print a JSON line\n"
+        "  -P pid        count cycles, instructions, cache/branch misses and context switches\n"
+        "                of the server process and report them per request\n", prog);
+}
+
+int main(int argc, char* argv[]){
+    LoadOptions opt;
+    int ch;
+    while((ch = getopt(argc, argv, "H:p:t:c:d:D:n:r:T:m:u:b:N:jP:")) != -1){
+        switch(ch){
+            case 'H': opt.host = optarg; break;
+            case 'p': opt.port = atoi(optarg); break;
+            case 't': opt.threads = std::max(1, atoi(optarg)); break;
+            case 'c': opt.connections = std::max(1, atoi(optarg)); break;
+            case 'd': opt.duration_s = std::max(1, atoi(optarg)); break;
+            case 'D': opt.depth = std::max(1, atoi(optarg)); break;
+            case 'n': opt.requests_per_conn = atoi(optarg); break;
+            case 'r': opt.rate = atof(optarg); break;
+            case 'T': opt.timeout_ms = std::max(1, atoi(optarg)); break;
+            case 'm': opt.method = optarg; break;
+            case 'u': opt.path = optarg; break;
+            case 'b': opt.body = optarg; break;
+            case 'N': opt.name = optarg; break;
+            case 'j': opt.json = true; break;
+            case 'P': opt.server_pid = atoi(optarg); break;
+            default: Usage(argv[0]); return 1;
+        }
+    }
+    opt.threads = std::min(opt.threads, opt.connections);
+    if(opt.rate < 0 || opt.rate / opt.threads > 1e9){
+        fprintf(stderr, "rate must be between 0 and 1e9 requests per second per thread\n");
+        return 1;
+    }
+    if(opt.name.empty())
+        opt.name = opt.method + " " + opt.path;
+
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(opt.port);
+    if(inet_pton(AF_INET, opt.host.c_str(), &addr.sin_addr) != 1){
+        fprintf(stderr, "invalid address %s\n", opt.host.c_str());
+        return 1;
+    }
+    signal(SIGPIPE, SIG_IGN);
+
+    std::vector<LoadWorker*> workers;
+    for(int i = 0; i < opt.threads; ++i){
+        int conns = opt.connections / opt.threads + (i < opt.connections % opt.threads ? 1 : 0);
+        workers.push_back(new LoadWorker(opt, conns, opt.rate / opt.threads, addr));
+    }
+
+    PerfCounter perf;
+    if(opt.server_pid > 0){
+        if(!perf.OpenProcess(opt.server_pid))
+            fprintf(stderr, "perf_event_open on pid %d failed, check /proc/sys/kernel/perf_event_paranoid\n", opt.server_pid);
+        else if(!perf.Unavailable().empty())
+            fprintf(stderr, "unavailable counters: %s\n", perf.Unavailable().c_str());
+    }
+    PerfSample perf_begin = perf.Read();
+
+    int64_t start = NowNs();
+    int64_t end = start + (int64_t)opt.duration_s * 1000000000;
+    std::vector<std::thread> threads;
+    for(LoadWorker* worker : workers)
+        threads.emplace_back([worker, end]{ worker->Run(end); });
+    for(std::thread& td : threads)
+        td.join();
+    double elapsed = (NowNs() - start) / 1e9;
+    PerfSample per_req = PerfCounter::Diff(perf_begin, perf.Read());
+
+    LoadStats total;
+    for(LoadWorker* worker : workers){
+        total.Merge(worker->Stats());
+        delete worker;
+    }
+
+    uint64_t errors = total.connect_errors + total.read_errors + total.timeouts + total.parse_errors;
+    const Histogram& lat = total.latency;
+    printf("scenario: %s, %d threads, %d connections, %ds, depth %d, %s, %s\n",
+            opt.name.c_str(), opt.threads, opt.connections, opt.duration_s, opt.depth,
+            opt.requests_per_conn > 0 ? ("churn every " + std::to_string(opt.requests_per_conn)).c_str() : "keep-alive",
+            opt.rate > 0 ? ("open loop " + std::to_string((long long)opt.rate) + "/s").c_str() : "closed loop");
+    printf("requests: %llu (%.1f/s), transfer: %.2f MB/s, connects: %llu\n",
+            (unsigned long long)total.completed, total.completed / elapsed, total.bytes / elapsed / 1048576.0,
+            (unsigned long long)total.connects);
+    printf("errors: %llu (connect %llu, read %llu, timeout %llu, parse %llu), unfinished: %llu\n",
+            (unsigned long long)errors, (unsigned long long)total.connect_errors, (unsigned long long)total.read_errors,
+            (unsigned long long)total.timeouts, (unsigned long long)total.parse_errors, (unsigned long long)total.unfinished);
+    printf("status:");
+    for(auto& item : total.status)
+        printf(" %d=%llu", item.first, (unsigned long long)item.second);
+    printf("\n");
+    printf("latency us: min %llu mean %.0f p50 %llu p90 %llu p99 %llu p99.9 %llu max %llu\n",
+            (unsigned long long)lat.Min(), lat.Mean(), (unsigned long long)lat.Percentile(50),
+            (unsigned long long)lat.Percentile(90), (unsigned long long)lat.Percentile(99),
+            (unsigned long long)lat.Percentile(99.9), (unsigned long long)lat.Max());
+
+    // 服务器的计数器平均到每个完成的请求，包括服务器处理超时和出错连接的开销
+    double ipc = -1;
+    if(perf.IsOpen()){
+        for(int i = 0; i < PC_NUM; ++i){
+            if(per_req.value[i] >= 0)
+                per_req.value[i] /= std::max<uint64_t>(total.completed, 1);
+        }
+        if(per_req.value[PC_CYCLES] > 0 && per_req.value[PC_INSTRUCTIONS] >= 0)
+            ipc = per_req.value[PC_INSTRUCTIONS] / per_req.value[PC_CYCLES];
+        printf("server per request:");
+        for(int i = 0; i < PC_NUM; ++i){
+            if(per_req.value[i] >= 0)
+                printf(" %s %.1f", PerfCounter::Name(i), per_req.value[i]);
+        }
+        if(ipc >= 0)
+            printf(" ipc %.2f", ipc);
+        printf("\n");
+    }
+
+    if(opt.json){
+        std::string perf_json;
+        for(int i = 0; perf.IsOpen() && i < PC_NUM; ++i){
+            if(per_req.value[i] >= 0)
+                perf_json += ",\"" + std::string(PerfCounter::Name(i)) + "_per_req\":" + std::to_string(per_req.value[i]);
+        }
+        if(ipc >= 0)
+            perf_json += ",\"ipc\":" + std::to_string(ipc);
+        printf("{\"scenario\":\"%s\",\"threads\":%d,\"connections\":%d,\"duration_s\":%d,\"depth\":%d,"
+                "\"requests_per_conn\":%d,\"rate\":%.0f,\"requests\":%llu,\"rps\":%.1f,\"mbps\":%.2f,\"errors\":%llu,"
+                "\"unfinished\":%llu,\"p50_us\":%llu,\"p90_us\":%llu,\"p99_us\":%llu,\"p999_us\":%llu,\"max_us\":%llu%s}\n",
+                opt.name.c_str(), opt.threads, opt.connections, opt.duration_s, opt.depth, opt.requests_per_conn, opt.rate,
+                (unsigned long long)total.completed, total.completed / elapsed, total.bytes / elapsed / 1048576.0,
+                (unsigned long long)errors, (unsigned long long)total.unfinished,
+                (unsigned long long)lat.Percentile(50), (unsigned long long)lat.Percentile(90),
+                (unsigned long long)lat.Percentile(99), (unsigned long long)lat.Percentile(99.9), (unsigned long long)lat.Max(),
+                perf_json.c_str());
+    }
+    return errors > 0 ? 2 : 0;
+}
@@ -0,0 +1,405 @@
+// 核心组件的微基准测试，输出每次操作的纳秒数，-j输出JSON便于不同提交之间对比。
+// 每个用例先按最短时间确定迭代次数，再重复运行若干轮取中位数。-p额外统计每次操作的硬件计数器
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <functional>
+#include <random>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+#include "../Buffer/buffer.h"
+#include "../Http/filecache.h"
+#include "../Http/httprequest.h"
+#include "../Http/httpresponse.h"
+#include "../Log/blockqueue.h"
+#include "../Log/log.h"
+#include "../Pool/threadpool.h"
+#include "../Timer/heaptimer.h"
+#include "perfcounter.h"
+
+struct BenchOptions{
+    double min_time_s = 0.2;        // 每轮至少运行多久
+    int runs = 5;                   // 重复轮数，取中位数
+    std::string filter;             // 只运行名字包含这个字符串的用例
+    std::string label;              // 输出JSON时附带的标签，比如提交号
+    std::string src_dir;            // 静态资源目录
+    bool json = false;
+    bool perf = false;              // 统计cycles、instructions等计数器
+};
+
+struct BenchResult{
+    std::string name;
+    double ns_per_op;
+    double min_ns;
+    double max_ns;
+    uint64_t ops;                   // 每轮的操作数
+    PerfSample perf;                // 所有轮次平均到每次操作的计数，没有统计时为-1
+};
+
+static BenchOptions g_opt;
+static std::vector<BenchResult> g_results;
+static PerfCounter g_perf;
+
+// 阻止编译器把结果优化掉
+template<class T>
+static void DoNotOptimize(const T& value){
+    asm volatile("" : : "r"(&value) : "memory");
+}
+
+static double NowNs(){
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static bool Selected(const std::string& name){
+    return g_opt.filter.empty() || name.find(g_opt.filter) != std::string::npos;
+}
+
+// 累加一轮测量的计数器增量
+static void AddPerf(PerfSample& total, const PerfSample& begin){
+    PerfSample diff = PerfCounter::Diff(begin, g_perf.Read());
+    for(int i = 0; i < PC_NUM; ++i)
+        total.value[i] = diff.value[i] < 0 ? -1 : total.value[i] + diff.value[i];
+}
+
+static double Ipc(const PerfSample& perf){
+    if(perf.value[PC_CYCLES] <= 0 || perf.value[PC_INSTRUCTIONS] < 0)
+        return -1;
+    return perf.value[PC_INSTRUCTIONS] / perf.value[PC_CYCLES];
+}
+
+static void Report(const std::string& name, std::vector<double>& samples, uint64_t ops, PerfSample perf){
+    std::sort(samples.begin(), samples.end());
+    for(int i = 0; i < PC_NUM; ++i){
+        if(perf.value[i] >= 0)
+            perf.value[i] /= (double)ops * samples.size();
+    }
+    BenchResult res = { name, samples[samples.size() / 2], samples.front(), samples.back(), ops, perf };
+    g_results.push_back(res);
+    if(!g_opt.json){
+        printf("%-40s %12.1f ns/op %14.0f ops/s   [%.1f .. %.1f] x%llu\n", name.c_str(), res.ns_per_op,
+                1e9 / res.ns_per_op, res.min_ns, res.max_ns, (unsigned long long)ops);
+        if(g_perf.IsOpen()){
+            printf("%40s", "");
+            for(int i = 0; i < PC_NUM; ++i){
+                if(perf.value[i] >= 0)
+                    printf(" %s %.2f", PerfCounter::Name(i), perf.value[i]);
+            }
+            if(Ipc(perf) >= 0)
+                printf(" ipc %.2f", Ipc(perf));
+            printf("\n");
+        }
+        fflush(stdout);
+    }
+}
+
+static PerfSample EmptyPerf(){
+    PerfSample perf;
+    for(int i = 0; i < PC_NUM; ++i)
+        perf.value[i] = g_perf.IsOpen() ? 0 : -1;
+    return perf;
+}
+
+// fn(iters)执行iters次操作。先倍增迭代次数直到一轮超过最短时间，再用这个次数重复测量
+static void Run(const std::string& name, const std::function<void(uint64_t)>& fn){
+    if(!Selected(name))
+        return;
+    uint64_t iters = 1;
+    while(true){
+        double start = NowNs();
+        fn(iters);
+        double elapsed = NowNs() - start;
+        if(elapsed >= g_opt.min_time_s * 1e9 || iters >= (1ull << 40))
+            break;
+        iters = elapsed < 1e6 ? iters * 10 : (uint64_t)(iters * g_opt.min_time_s * 1e9 / elapsed * 1.2) + 1;
+    }
+
+    std::vector<double> samples;
+    PerfSample perf = EmptyPerf();
+    for(int i = 0; i < g_opt.runs; ++i){
+        PerfSample begin = g_perf.Read();
+        double start = NowNs();
+        fn(iters);
+        samples.push_back((NowNs() - start) / iters);
+        AddPerf(perf, begin);
+    }
+    Report(name, samples, iters, perf);
+}
+
+// 一轮固定做ops次操作的用例，比如建好百万个定时器再全部到期。setup不计时
+static void RunBatch(const std::string& name, uint64_t ops, const std::function<void()>& setup, const std::function<void()>& fn){
+    if(!Selected(name))
+        return;
+    std::vector<double> samples;
+    PerfSample perf = EmptyPerf();
+    for(int i = 0; i < g_opt.runs; ++i){
+        setup();
+        PerfSample begin = g_perf.Read();
+        double start = NowNs();
+        fn();
+        samples.push_back((NowNs() - start) / ops);
+        AddPerf(perf, begin);
+    }
+    Report(name, samples, ops, perf);
+}
+
+static void BenchBuffer(){
+    for(std::size_t len : {64, 1024, 16384}){
+        std::string data(len, 'x');
+        Run("buffer_append_retrieve/" + std::to_string(len), [&](uint64_t iters){
+            Buffer buff;
+            for(uint64_t i = 0; i < iters; ++i){
+                buff.Append(data);
+                buff.Retrieve(len);
+            }
+            DoNotOptimize(buff);
+        });
+    }
+
+    // 每次先往管道写入len字节再用ReadFd读出，包括write(2)的开销
+    for(std::size_t len : {1024, 16384}){
+        int fds[2];
+        if(pipe(fds) < 0)
+            return;
+        std::string data(len, 'x');
+        Run("buffer_readfd/" + std::to_string(len), [&](uint64_t iters){
+            Buffer buff;
+            int err = 0;
+            for(uint64_t i = 0; i < iters; ++i){
+                if(write(fds[1], data.data(), len) < 0)
+                    break;
+                buff.ReadFd(fds[0], &err);
+                buff.RetrieveAll();
+            }
+        });
+        close(fds[0]);
+        close(fds[1]);
+    }
+}
+
+// 请求样本：简单GET，浏览器带完整头部的GET，登录表单POST
+static const char* REQUEST_CORPUS[][2] = {
+    { "get_minimal", "GET /index.html HTTP/1.1\r\nHost: 127.0.0.1:1316\r\n\r\n" },
+    { "get_browser",
+        "GET /picture.html HTTP/1.1\r\n"
+        "Host: 127.0.0.1:1316\r\n"
+        "Connection: keep-alive\r\n"
+        "Cache-Control: max-age=0\r\n"
+        "Upgrade-Insecure-Requests: 1\r\n"
+        "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/120.0.0.0 Safari/537.36\r\n"
+        "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,image/avif,image/webp,*/*;q=0.8\r\n"
+        "Referer: http://127.0.0.1:1316/index.html\r\n"
+        "Accept-Encoding: gzip, deflate, br\r\n"
+        "Accept-Language: zh-CN,zh;q=0.9,en;q=0.8\r\n"
+        "Cookie: sid=0123456789abcdef0123456789abcdef; theme=dark\r\n\r\n" },
+    { "post_login",
+        "POST /login HTTP/1.1\r\n"
+        "Host: 127.0.0.1:1316\r\n"
+        "Connection: keep-alive\r\n"
+        "Content-Type: application/x-www-form-urlencoded\r\n"
+        "Content-Length: 29\r\n"
+        "Origin: http://127.0.0.1:1316\r\n"
+        "Referer: http://127.0.0.1:1316/login.html\r\n\r\n"
+        "user=someone&password=secret1" },
+};
+
+static void BenchRequest(){
+    for(auto& sample : REQUEST_CORPUS){
+        std::string text = sample[1];
+        Run(std::string("request_parse/") + sample[0], [&](uint64_t iters){
+            Buffer buff;
+            HttpRequest request;
+            for(uint64_t i = 0; i < iters; ++i){
+                buff.Append(text);
+                request.Init();
+                request.Parse(buff);
+                buff.RetrieveAll();
+            }
+            DoNotOptimize(request);
+        });
+    }
+}
+
+static void BenchResponse(const std::string& suffix){
+    for(const char* path : {"/index.html", "/picture.html", "/no/such/file.html"}){
+        std::string name = std::string("response_make/") + (path + 1);
+        std::replace(name.begin() + 14, name.end(), '/', '_');
+        Run(name + suffix, [&](uint64_t iters){
+            Buffer buff;
+            HttpResponse response;
+            for(uint64_t i = 0; i < iters; ++i){
+                response.Init(g_opt.src_dir, path, true, 200);
+                response.MakeResponse(buff);
+                buff.RetrieveAll();
+                response.UnmapFile();
+            }
+        });
+    }
+}
+
+// 定时器的超时是毫秒，随机分布在10分钟内，测试期间不会有定时器自然到期
+static void BenchTimer(){
+    for(int num : {10000, 100000, 1000000}){
+        std::vector<int> timeouts(num);
+        std::mt19937 rng(num);
+        for(int& t : timeouts)
+            t = 1000 + rng() % 600000;
+
+        HeapTimer* timer = nullptr;
+        RunBatch("timer_add/" + std::to_string(num), num, [&]{
+            delete timer;
+            timer = new HeapTimer;
+        }, [&]{
+            for(int i = 0; i < num; ++i)
+                timer->Add(i, timeouts[i], []{});
+        });
+
+        // 在num个定时器中随机顺延，和连接收到数据时顺延超时一样
+        int adjusts = std::min(num, 100000);
+        RunBatch("timer_adjust/" + std::to_string(num), adjusts, []{}, [&]{
+            for(int i = 0; i < adjusts; ++i)
+                timer->Adjust(timeouts[i] % num, 600000 + i);
+        });
+
+        // 全部立即到期，一次Tick处理完，每次操作是一个定时器出堆并回调
+        RunBatch("timer_tick/" + std::to_string(num), num, [&]{
+            timer->Clear();
+            for(int i = 0; i < num; ++i)
+                timer->Add(i, 0, []{});
+        }, [&]{
+            timer->Tick();
+        });
+        delete timer;
+    }
+}
+
+// 生产者和消费者数量相同，每次操作是一个元素入队并出队
+static void BenchBlockQueue(){
+    for(int pairs : {1, 4}){
+        const uint64_t total = 400000;
+        RunBatch("blockqueue_push_pop/" + std::to_string(pairs) + "p" + std::to_string(pairs) + "c", total, []{}, [&]{
+            BlockQueue<int> queue(1024);
+            std::vector<std::thread> threads;
+            for(int p = 0; p < pairs; ++p){
+                threads.emplace_back([&]{
+                    for(uint64_t i = 0; i < total / pairs; ++i)
+                        queue.push_back((int)i);
+                });
+                threads.emplace_back([&]{
+                    int elem;
+                    for(uint64_t i = 0; i < total / pairs; ++i)
+                        queue.pop_front(elem);
+                });
+            }
+            for(auto& td : threads)
+                td.join();
+        });
+    }
+}
+
+// 提交空任务直到全部执行完，每次操作是一次commit加执行
+static void BenchThreadPool(){
+    for(int producers : {1, 4}){
+        const uint64_t total = 200000;
+        RunBatch("threadpool_commit/" + std::to_string(producers) + "producer", total, []{}, [&]{
+            std::atomic<uint64_t> done(0);
+            std::vector<std::thread> threads;
+            for(int p = 0; p < producers; ++p){
+                threads.emplace_back([&]{
+                    for(uint64_t i = 0; i < total / producers; ++i)
+                        ThreadPool::Instance().commit([&done]{ done.fetch_add(1, std::memory_order_relaxed); });
+                });
+            }
+            for(auto& td : threads)
+                td.join();
+            while(done.load() < total / producers * producers)
+                std::this_thread::yield();
+        });
+    }
+}
+
+// 和服务器中的LOG_INFO一样，每条日志写完都flush
+static void BenchLog(){
+    if(!Selected("log_write"))
+        return;
+    char dir[] = "/tmp/microbench_logXXXXXX";
+    if(!mkdtemp(dir))
+        return;
+    Log::instance().init(1, dir, ".log", 1024);
+    Run("log_write", [](uint64_t iters){
+        for(uint64_t i = 0; i < iters; ++i){
+            LOG_INFO("Client[%d](%s:%d) in, userCount:%d", 12, "127.0.0.1", 40000, (int)i);
+        }
+    });
+    Log::instance().flush();
+    std::string cmd = std::string("rm -rf ") + dir;
+    if(system(cmd.c_str()) != 0)
+        fprintf(stderr, "remove %s failed\n", dir);
+}
+
+static void PrintJson(){
+    printf("{\"label\":\"%s\",\"cpus\":%u,\"benchmarks\":[", g_opt.label.c_str(), std::thread::hardware_concurrency());
+    for(std::size_t i = 0; i < g_results.size(); ++i){
+        const BenchResult& res = g_results[i];
+        printf("%s\n{\"name\":\"%s\",\"ns_per_op\":%.2f,\"ops_per_sec\":%.0f,\"min_ns\":%.2f,\"max_ns\":%.2f,\"ops\":%llu,\"runs\":%d",
+                i ? "," : "", res.name.c_str(), res.ns_per_op, 1e9 / res.ns_per_op, res.min_ns, res.max_ns,
+                (unsigned long long)res.ops, g_opt.runs);
+        for(int j = 0; j < PC_NUM; ++j){
+            if(res.perf.value[j] >= 0)
+                printf(",\"%s_per_op\":%.3f", PerfCounter::Name(j), res.perf.value[j]);
+        }
+        if(Ipc(res.perf) >= 0)
+            printf(",\"ipc\":%.3f", Ipc(res.perf));
+        printf("}");
+    }
+    printf("\n]}\n");
+}
+
+int main(int argc, char* argv[]){
+    int ch;
+    while((ch = getopt(argc, argv, "f:l:r:s:t:jp")) != -1){
+        switch(ch){
+            case 'f': g_opt.filter = optarg; break;
+            case 'l': g_opt.label = optarg; break;
+            case 'r': g_opt.runs = std::max(1, atoi(optarg)); break;
+            case 's': g_opt.src_dir = optarg; break;
+            case 't': g_opt.min_time_s = atof(optarg); break;
+            case 'j': g_opt.json = true; break;
+            case 'p': g_opt.perf = true; break;
+            default:
+                fprintf(stderr, "usage: %s [-f filter] [-t min_seconds] [-r runs] [-s resources_dir] [-l label] [-j] [-p]\n", argv[0]);
+                return 1;
+        }
+    }
+    if(g_opt.src_dir.empty()){
+        char* cwd = getcwd(nullptr, 256);
+        g_opt.src_dir = std::string(cwd) + "/resources/";          // 和服务器一样在bin目录下运行
+        free(cwd);
+    }
+
+    if(g_opt.perf){             // 在线程池和日志线程创建之前打开，这些线程也计入
+        if(!g_perf.OpenSelf())
+            fprintf(stderr, "perf_event_open failed, check /proc/sys/kernel/perf_event_paranoid\n");
+        else if(!g_perf.Unavailable().empty())
+            fprintf(stderr, "unavailable counters: %s\n", g_perf.Unavailable().c_str());
+    }
+
+    BenchBuffer();
+    BenchRequest();
+    BenchResponse("");
+    FileCache::Instance().Init(256 * 1024, 64 * 1024 * 1024);       // 打开后无法关闭，放在不带缓存的用例之后
+    BenchResponse("_cached");
+    BenchTimer();
+    BenchBlockQueue();
+    BenchThreadPool();
+    BenchLog();
+
+    if(g_opt.json)
+        PrintJson();
+    return 0;
+}
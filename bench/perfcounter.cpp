@@ -0,0 +1,124 @@
+#include "perfcounter.h"
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+static const struct{
+    const char* name;
+    uint32_t type;
+    uint64_t config;
+} PERF_EVENTS[PC_NUM] = {
+    { "cycles",           PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+    { "instructions",     PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+    { "cache_misses",     PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+    { "branch_misses",    PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+    { "context_switches", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES },
+};
+
+PerfCounter::~PerfCounter(){
+    Close();
+}
+
+void PerfCounter::Close(){
+    for(int i = 0; i < PC_NUM; ++i){
+        for(int fd : fds_[i])
+            close(fd);
+        fds_[i].clear();
+    }
+}
+
+bool PerfCounter::IsOpen() const {
+    for(int i = 0; i < PC_NUM; ++i){
+        if(!fds_[i].empty())
+            return true;
+    }
+    return false;
+}
+
+const char* PerfCounter::Name(int counter){
+    return PERF_EVENTS[counter].name;
+}
+
+std::string PerfCounter::Unavailable() const {
+    std::string names;
+    for(int i = 0; i < PC_NUM; ++i){
+        if(fds_[i].empty())
+            names += std::string(names.empty() ? "" : ",") + PERF_EVENTS[i].name;
+    }
+    return names;
+}
+
+// 只统计用户态和内核态，不统计虚拟机监控程序。inherit让之后创建的线程也计入，读数包括还在运行的子线程
+bool PerfCounter::OpenThread(pid_t tid, bool inherit){
+    bool opened = false;
+    for(int i = 0; i < PC_NUM; ++i){
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_EVENTS[i].type;
+        attr.config = PERF_EVENTS[i].config;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        attr.inherit = inherit;
+        attr.exclude_hv = 1;
+        int fd = syscall(SYS_perf_event_open, &attr, tid, -1, -1, PERF_FLAG_FD_CLOEXEC);
+        if(fd < 0){
+            attr.exclude_kernel = 1;            // perf_event_paranoid为2时只允许统计用户态
+            fd = syscall(SYS_perf_event_open, &attr, tid, -1, -1, PERF_FLAG_FD_CLOEXEC);
+        }
+        if(fd >= 0){
+            fds_[i].push_back(fd);
+            opened = true;
+        }
+    }
+    return opened;
+}
+
+bool PerfCounter::OpenSelf(){
+    Close();
+    return OpenThread(0, true);
+}
+
+// 服务器的线程在启动时就都创建好了，逐个线程打开计数器
+bool PerfCounter::OpenProcess(pid_t pid){
+    Close();
+    std::string task_dir = "/proc/" + std::to_string(pid) + "/task";
+    DIR* dir = opendir(task_dir.c_str());
+    if(!dir)
+        return false;
+    struct dirent* entry;
+    while((entry = readdir(dir)) != nullptr){
+        if(entry->d_name[0] == '.')
+            continue;
+        OpenThread(atoi(entry->d_name), false);
+    }
+    closedir(dir);
+    return IsOpen();
+}
+
+// 计数器数量超过硬件寄存器时内核会轮流计数，按实际运行时间的比例放大
+PerfSample PerfCounter::Read() const {
+    PerfSample sample;
+    for(int i = 0; i < PC_NUM; ++i){
+        sample.value[i] = fds_[i].empty() ? -1 : 0;
+        for(int fd : fds_[i]){
+            uint64_t data[3];           // value, time_enabled, time_running
+            if(read(fd, data, sizeof(data)) != sizeof(data))
+                continue;
+            if(data[2] > 0 && data[2] < data[1])
+                sample.value[i] += (double)data[0] * data[1] / data[2];
+            else
+                sample.value[i] += data[0];
+        }
+    }
+    return sample;
+}
+
+PerfSample PerfCounter::Diff(const PerfSample& begin, const PerfSample& end){
+    PerfSample diff;
+    for(int i = 0; i < PC_NUM; ++i)
+        diff.value[i] = (begin.value[i] < 0 || end.value[i] < 0) ? -1 : end.value[i] - begin.value[i];
+    return diff;
+}
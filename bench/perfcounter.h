@@ -0,0 +1,50 @@
+#ifndef PERFCOUNTER_H
+#define PERFCOUNTER_H
+
+#include <cstdint>
+#include <string>
+#include <sys/types.h>
+#include <vector>
+
+// 压测时统计的硬件和软件计数器
+enum PERF_COUNTER{
+    PC_CYCLES = 0,
+    PC_INSTRUCTIONS,
+    PC_CACHE_MISSES,
+    PC_BRANCH_MISSES,
+    PC_CONTEXT_SWITCHES,
+    PC_NUM
+};
+
+// 一次读数，计数器打不开时对应的值为-1
+struct PerfSample{
+    double value[PC_NUM];
+};
+
+// 用perf_event_open统计一段代码的cycles、instructions等。计数器打开后一直运行，
+// 在测量区间前后各Read一次再相减，不需要反复开关。虚拟机和容器里经常没有硬件计数器，
+// 或者被perf_event_paranoid禁止，这时打不开的计数器读数为-1，不影响其他计数器
+class PerfCounter{
+public:
+    PerfCounter() = default;
+    ~PerfCounter();
+    PerfCounter(const PerfCounter&) = delete;
+    PerfCounter& operator=(const PerfCounter&) = delete;
+
+    bool OpenSelf();                // 当前线程以及之后创建的线程
+    bool OpenProcess(pid_t pid);    // 另一个进程现有的所有线程，例如压测时的服务器
+    void Close();
+    bool IsOpen() const;
+    std::string Unavailable() const;        // 打不开的计数器名，逗号分隔
+
+    PerfSample Read() const;
+    static PerfSample Diff(const PerfSample& begin, const PerfSample& end);
+    static const char* Name(int counter);
+
+private:
+    bool OpenThread(pid_t tid, bool inherit);
+
+    std::vector<int> fds_[PC_NUM];          // 每个计数器在每个线程上一个fd
+};
+
+#endif
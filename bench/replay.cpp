@@ -0,0 +1,378 @@
+// 回放服务器用-C抓到的请求：按记录的连接号建立连接，按原来的时间间隔(可以按倍数加速)发送同样的字节，
+// 同一连接的请求拆包、流水线和keep-alive都和抓包时一致。响应只读取计数，不解析。
+// 单线程epoll驱动，发送时间落后计划的量作为回放本身的误差一并输出
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <iterator>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <signal.h>
+#include <string>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+#include "../Capture/capture.h"
+
+constexpr int MAX_EVENTS = 256;
+
+struct ReplayOptions{
+    std::string host = "127.0.0.1";
+    int port = 1316;
+    double speed = 1;               // 回放速度倍数，0为不等待，尽快发送
+    int drain_ms = 2000;            // 最后一条记录之后等待响应的时间
+    std::string file;
+    std::string name;               // 只用于输出
+    bool json = false;
+};
+
+// 抓包中的一条记录，数据指向读入内存的文件
+struct ReplayEvent{
+    int64_t at_us;                  // 距抓包开始的微秒数
+    uint64_t conn;
+    uint8_t type;
+    std::size_t offset;
+    std::size_t len;
+};
+
+struct ReplayConn{
+    int fd = -1;
+    bool connected = false;
+    bool closing = false;           // 抓包中客户端先关闭了连接，发完剩下的数据后半关闭，等服务器关闭
+    bool answered = true;           // 最后一次发送之后收到过响应
+    bool shut = false;
+    std::string out;                // 还没发出去的请求字节
+};
+
+struct ReplayStats{
+    uint64_t conns = 0;
+    uint64_t events = 0;
+    uint64_t bytes_sent = 0;
+    uint64_t bytes_recv = 0;
+    uint64_t connect_errors = 0;
+    uint64_t io_errors = 0;
+    uint64_t unfinished = 0;        // 等待结束时服务器还没关闭的连接，和抓包时的行为不一致
+    int64_t lag_sum_us = 0;
+    int64_t lag_max_us = 0;
+};
+
+static int64_t NowUs(){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static bool GetVarint(const std::string& data, std::size_t& pos, uint64_t& value){
+    value = 0;
+    for(int shift = 0; shift < 64 && pos < data.size(); shift += 7){
+        uint8_t byte = data[pos++];
+        value |= (uint64_t)(byte & 0x7f) << shift;
+        if(!(byte & 0x80))
+            return true;
+    }
+    return false;
+}
+
+// 解析整个抓包文件，文件不完整时(例如服务器被杀掉)保留已经完整的记录
+static bool LoadCapture(const std::string& file, std::string& data, std::vector<ReplayEvent>& events, int64_t& start_unix_us){
+    std::ifstream in(file, std::ios::binary);
+    if(!in)
+        return false;
+    data.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    if(data.size() < 16 || memcmp(data.data(), CAPTURE_MAGIC, sizeof(CAPTURE_MAGIC)) != 0)
+        return false;
+    start_unix_us = 0;
+    for(int i = 0; i < 8; ++i)
+        start_unix_us |= (int64_t)(uint8_t)data[8 + i] << (8 * i);
+
+    std::size_t pos = 16;
+    int64_t at_us = 0;
+    while(pos < data.size()){
+        ReplayEvent ev;
+        uint64_t delta, len = 0;
+        ev.type = data[pos++];
+        if(!GetVarint(data, pos, delta) || !GetVarint(data, pos, ev.conn))
+            break;
+        if(ev.type == CAP_DATA && (!GetVarint(data, pos, len) || len > data.size() - pos))
+            break;
+        if(ev.type < CAP_OPEN || ev.type > CAP_PEER_CLOSE){
+            fprintf(stderr, "bad record type %d at offset %zu\n", ev.type, pos);
+            return false;
+        }
+        at_us += delta;
+        ev.at_us = at_us;
+        ev.offset = pos;
+        ev.len = len;
+        pos += len;
+        events.push_back(ev);
+    }
+    return true;
+}
+
+class Replayer{
+public:
+    Replayer(const ReplayOptions& opt, const sockaddr_in& addr, const std::string& data) :
+        opt_(opt), addr_(addr), data_(data), epfd_(epoll_create1(EPOLL_CLOEXEC)) {}
+
+    ~Replayer(){
+        for(auto& item : conns_){
+            if(item.second.fd >= 0)
+                close(item.second.fd);
+        }
+        close(epfd_);
+    }
+
+    void Run(const std::vector<ReplayEvent>& events){
+        int64_t start = NowUs();
+        std::size_t next = 0;
+        int64_t drain_end = 0;
+        while(true){
+            int64_t now = NowUs();
+            while(next < events.size() && (opt_.speed <= 0 || start + (int64_t)(events[next].at_us / opt_.speed) <= now)){
+                if(opt_.speed > 0){
+                    int64_t lag = now - start - (int64_t)(events[next].at_us / opt_.speed);
+                    stats_.lag_sum_us += lag;
+                    stats_.lag_max_us = std::max(stats_.lag_max_us, lag);
+                }
+                Apply(events[next++]);
+                if(opt_.speed <= 0 && next % 64 == 0)
+                    break;              // 不等待时也定期处理响应，避免服务器的发送缓冲区堆满
+            }
+
+            int timeout_ms;
+            if(next < events.size()){
+                int64_t wait_us = opt_.speed > 0 ? start + (int64_t)(events[next].at_us / opt_.speed) - NowUs() : 0;
+                timeout_ms = wait_us > 1000 ? (int)(wait_us / 1000) : 0;     // 不到1ms的间隔用0超时轮询，保持回放精度
+            }else{
+                if(drain_end == 0)
+                    drain_end = NowUs() + (int64_t)opt_.drain_ms * 1000;
+                if(conns_.empty() || NowUs() >= drain_end)
+                    break;
+                timeout_ms = (int)((drain_end - NowUs()) / 1000) + 1;
+            }
+
+            struct epoll_event evs[MAX_EVENTS];
+            int n = epoll_wait(epfd_, evs, MAX_EVENTS, timeout_ms);
+            for(int i = 0; i < n; ++i)
+                OnEvent(evs[i].data.u64, evs[i].events);
+        }
+        stats_.unfinished = conns_.size();
+        elapsed_us_ = NowUs() - start;
+    }
+
+    const ReplayStats& Stats() const { return stats_; }
+    int64_t Elapsed() const { return elapsed_us_; }
+
+private:
+    void Apply(const ReplayEvent& ev){
+        stats_.events++;
+        if(ev.type == CAP_OPEN){
+            Connect(ev.conn);
+            return;
+        }
+        auto it = conns_.find(ev.conn);
+        if(it == conns_.end())
+            return;             // 连接建立失败，或者抓包开始前就存在的连接
+        if(ev.type == CAP_DATA){
+            it->second.out.append(data_, ev.offset, ev.len);
+        }else if(ev.type == CAP_PEER_CLOSE){
+            it->second.closing = true;
+        }else{
+            return;             // 服务器主动关闭的连接，等服务器自己关闭
+        }
+        Flush(ev.conn, it->second);
+    }
+
+    void Connect(uint64_t id){
+        int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if(fd < 0){
+            stats_.connect_errors++;
+            return;
+        }
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        if(connect(fd, (sockaddr*)&addr_, sizeof(addr_)) < 0 && errno != EINPROGRESS){
+            close(fd);
+            stats_.connect_errors++;
+            return;
+        }
+        ReplayConn& conn = conns_[id];
+        conn.fd = fd;
+        stats_.conns++;
+        struct epoll_event ev{};
+        ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+        ev.data.u64 = id;
+        epoll_ctl(epfd_, EPOLL_CTL_ADD, fd, &ev);
+    }
+
+    // 尽量发出积压的请求字节。抓包中客户端已经关闭的，等发完并且收到响应后再半关闭写方向，
+    // 回放落后时不会把最后的请求和FIN一起发出去，让服务器来不及响应就关闭连接
+    void Flush(uint64_t id, ReplayConn& conn){
+        if(!conn.connected)
+            return;
+        while(!conn.out.empty()){
+            ssize_t len = send(conn.fd, conn.out.data(), conn.out.size(), MSG_NOSIGNAL);
+            if(len < 0){
+                if(errno == EAGAIN)
+                    return;
+                stats_.io_errors++;
+                Drop(id, conn);
+                return;
+            }
+            stats_.bytes_sent += len;
+            conn.out.erase(0, len);
+            conn.answered = false;
+        }
+        if(conn.closing && conn.answered && !conn.shut){
+            shutdown(conn.fd, SHUT_WR);
+            conn.shut = true;
+        }
+    }
+
+    void OnEvent(uint64_t id, uint32_t events){
+        auto it = conns_.find(id);
+        if(it == conns_.end())
+            return;
+        ReplayConn& conn = it->second;
+        if(!conn.connected && (events & (EPOLLOUT | EPOLLERR))){
+            int err = 0;
+            socklen_t len = sizeof(err);
+            getsockopt(conn.fd, SOL_SOCKET, SO_ERROR, &err, &len);
+            if(err != 0){
+                stats_.connect_errors++;
+                Drop(id, conn);
+                return;
+            }
+            conn.connected = true;
+        }
+        if(events & EPOLLOUT){
+            Flush(id, conn);
+            if(conns_.count(id) == 0)
+                return;
+        }
+        if(events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)){
+            char buf[64 * 1024];
+            while(true){
+                ssize_t len = recv(conn.fd, buf, sizeof(buf), 0);
+                if(len > 0){
+                    stats_.bytes_recv += len;
+                    conn.answered = true;
+                    continue;
+                }
+                if(len == 0 || errno != EAGAIN){
+                    if(len < 0 || !conn.out.empty())
+                        stats_.io_errors++;             // 服务器在请求发完之前关闭了连接
+                    Drop(id, conn);
+                }else{
+                    Flush(id, conn);
+                }
+                return;
+            }
+        }
+    }
+
+    void Drop(uint64_t id, ReplayConn& conn){
+        epoll_ctl(epfd_, EPOLL_CTL_DEL, conn.fd, nullptr);
+        close(conn.fd);
+        conns_.erase(id);
+    }
+
+private:
+    const ReplayOptions& opt_;
+    sockaddr_in addr_;
+    const std::string& data_;
+    int epfd_;
+    std::unordered_map<uint64_t, ReplayConn> conns_;
+    ReplayStats stats_;
+    int64_t elapsed_us_ = 0;
+};
+
+static void Usage(const char* prog){
+    fprintf(stderr,
+        "usage: %s [options] capture_file\n"
+        "  -H host       server address, default 127.0.0.1\n"
+        "  -p port       default 1316\n"
+        "  -s speed      replay speed multiplier, 0 sends as fast as possible, default 1\n"
+        "  -w ms         wait this long for responses after the last record, default 2000\n"
+        "  -N name       name for the report\n"
+        "  -j            also print a JSON line\n", prog);
+}
+
+int main(int argc, char* argv[]){
+    ReplayOptions opt;
+    int ch;
+    while((ch = getopt(argc, argv, "H:p:s:w:N:j")) != -1){
+        switch(ch){
+            case 'H': opt.host = optarg; break;
+            case 'p': opt.port = atoi(optarg); break;
+            case 's': opt.speed = std::max(0.0, atof(optarg)); break;
+            case 'w': opt.drain_ms = std::max(0, atoi(optarg)); break;
+            case 'N': opt.name = optarg; break;
+            case 'j': opt.json = true; break;
+            default: Usage(argv[0]); return 1;
+        }
+    }
+    if(optind >= argc){
+        Usage(argv[0]);
+        return 1;
+    }
+    opt.file = argv[optind];
+    if(opt.name.empty())
+        opt.name = opt.file;
+
+    std::string data;
+    std::vector<ReplayEvent> events;
+    int64_t start_unix_us;
+    if(!LoadCapture(opt.file, data, events, start_unix_us)){
+        fprintf(stderr, "%s is not a capture file\n", opt.file.c_str());
+        return 1;
+    }
+
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(opt.port);
+    if(inet_pton(AF_INET, opt.host.c_str(), &addr.sin_addr) != 1){
+        fprintf(stderr, "invalid address %s\n", opt.host.c_str());
+        return 1;
+    }
+    signal(SIGPIPE, SIG_IGN);
+
+    Replayer replayer(opt, addr, data);
+    replayer.Run(events);
+    const ReplayStats& stats = replayer.Stats();
+    double elapsed = replayer.Elapsed() / 1e6;
+    double captured = events.empty() ? 0 : events.back().at_us / 1e6;
+    double lag_mean = stats.events > 0 && opt.speed > 0 ? (double)stats.lag_sum_us / stats.events : 0;
+
+    time_t start_s = start_unix_us / 1000000;
+    char start_str[32];
+    strftime(start_str, sizeof(start_str), "%Y-%m-%d %H:%M:%S", localtime(&start_s));
+    printf("capture: %s, started %s, %zu records over %.2fs\n", opt.file.c_str(), start_str, events.size(), captured);
+    printf("replay: %.2fx, %.2fs, %llu connections, sent %llu bytes, received %llu bytes (%.2f MB/s)\n",
+            opt.speed, elapsed, (unsigned long long)stats.conns, (unsigned long long)stats.bytes_sent,
+            (unsigned long long)stats.bytes_recv, stats.bytes_recv / elapsed / 1048576.0);
+    printf("errors: connect %llu, io %llu, unfinished %llu; schedule lag us: mean %.0f max %lld\n",
+            (unsigned long long)stats.connect_errors, (unsigned long long)stats.io_errors,
+            (unsigned long long)stats.unfinished, lag_mean, (long long)stats.lag_max_us);
+
+    if(opt.json){
+        printf("{\"replay\":\"%s\",\"speed\":%.2f,\"records\":%zu,\"capture_s\":%.3f,\"elapsed_s\":%.3f,\"connections\":%llu,"
+                "\"bytes_sent\":%llu,\"bytes_recv\":%llu,\"connect_errors\":%llu,\"io_errors\":%llu,\"unfinished\":%llu,"
+                "\"lag_mean_us\":%.0f,\"lag_max_us\":%lld}\n",
+                opt.name.c_str(), opt.speed, events.size(), captured, elapsed, (unsigned long long)stats.conns,
+                (unsigned long long)stats.bytes_sent, (unsigned long long)stats.bytes_recv,
+                (unsigned long long)stats.connect_errors, (unsigned long long)stats.io_errors,
+                (unsigned long long)stats.unfinished, lag_mean, (long long)stats.lag_max_us);
+    }
+    return stats.connect_errors + stats.io_errors > 0 ? 2 : 0;
+}
@@ -0,0 +1,48 @@
+#!/bin/sh
+# 用bin/bench跑一组固定场景，每个场景输出一行JSON，便于不同提交之间对比
+# 用法: bench/scenarios.sh [每个场景的秒数] [输出文件]
+# 需要先编译好bin/TinyWebServer和bin/bench，并且1316端口空闲。SERVER_ARGS可以给服务器传参数，例如SERVER_ARGS="-b uring"
+# PERF=1时同时统计服务器每个请求的cycles、instructions、cache/branch miss和上下文切换
+
+DURATION=${1:-10}
+BIN_DIR=$(cd "$(dirname "$0")/../bin" && pwd)
+OUT=${2:-$BIN_DIR/bench_$(git -C "$BIN_DIR" rev-parse --short HEAD 2>/dev/null || echo local).jsonl}
+THREADS=${THREADS:-2}
+
+# 大文件场景用video.html里引用的视频，仓库里没有，临时生成一个
+VIDEO="$BIN_DIR/resources/video/xxx.mp4"
+if [ ! -f "$VIDEO" ]; then
+    mkdir -p "$(dirname "$VIDEO")"
+    head -c 64M /dev/urandom > "$VIDEO"
+    CREATED_VIDEO=1
+fi
+
+cd "$BIN_DIR" || exit 1
+./TinyWebServer $SERVER_ARGS > /dev/null 2>&1 &
+pid=$!
+sleep 1
+
+run(){
+    name=$1
+    shift
+    echo "== $name"
+    ./bench -t "$THREADS" -d "$DURATION" -N "$name" -j ${PERF:+-P $pid} "$@" | tee /tmp/scenario_$$.txt | grep -v '^{'
+    grep '^{' /tmp/scenario_$$.txt >> "$OUT"
+}
+
+: > "$OUT"
+run static      -c 100 -u /index.html
+run static-rate -c 100 -u /index.html -r 2000
+run churn       -c 50  -u /index.html -n 1
+run video       -c 8   -u /video/xxx.mp4 -T 30000
+run login       -c 50  -m POST -u /login -b "user=bench&password=bench"
+run notfound    -c 100 -u /no/such/file.html
+
+kill -INT $pid
+wait $pid 2>/dev/null
+rm -f /tmp/scenario_$$.txt
+if [ -n "$CREATED_VIDEO" ]; then
+    rm -f "$VIDEO"
+    rmdir "$(dirname "$VIDEO")" 2>/dev/null
+fi
+echo "results: $OUT"
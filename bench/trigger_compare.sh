@@ -0,0 +1,54 @@
+#!/bin/sh
+# 对比四种触发模式(-m 0~3)的每秒请求数和每个请求的平均耗时
+# 用法: bench/trigger_compare.sh [请求数] [并发连接数] [路径]
+# 需要先编译好bin/TinyWebServer，并且1316端口空闲。SERVER可以指定要测试的可执行文件，默认bin/TinyWebServer
+
+REQUESTS=${1:-4000}
+CONNS=${2:-4}
+URL_PATH=${3:-/index.html}
+URL="http://127.0.0.1:1316${URL_PATH}"
+BIN_DIR=$(cd "$(dirname "$0")/../bin" && pwd)
+SERVER=${SERVER:-./TinyWebServer}
+
+run_mode(){
+    mode=$1
+    cd "$BIN_DIR" || exit 1
+    $SERVER -m "$mode" > /dev/null 2>&1 &
+    pid=$!
+    sleep 1
+
+    per_conn=$((REQUESTS / CONNS))
+    urls=$(i=0; while [ $i -lt $per_conn ]; do printf -- '-o /dev/null %s ' "$URL"; i=$((i + 1)); done)
+
+    start=$(date +%s%N)
+    c=0
+    curl_pids=""
+    while [ $c -lt "$CONNS" ]; do
+        # 每个curl进程在一条keep-alive连接上顺序发送per_conn个请求
+        curl -s -H "Connection: keep-alive" $urls &
+        curl_pids="$curl_pids $!"
+        c=$((c + 1))
+    done
+    for p in $curl_pids; do
+        wait "$p"
+    done
+    end=$(date +%s%N)
+
+    kill -INT $pid
+    wait $pid 2>/dev/null
+
+    total=$((per_conn * CONNS))
+    ns=$((end - start))
+    case $mode in
+        0) name="LT/LT" ;;
+        1) name="LT/ET" ;;
+        2) name="ET/LT" ;;
+        *) name="ET/ET" ;;
+    esac
+    printf 'listen/conn=%-6s requests=%d conns=%d rps=%d us_per_request=%d\n' \
+        "$name" "$total" "$CONNS" $((total * 1000000000 / ns)) $((ns / total / 1000))
+}
+
+for m in 0 1 2 3; do
+    run_mode $m
+done
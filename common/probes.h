@@ -0,0 +1,26 @@
+#ifndef PROBES_H
+#define PROBES_H
+
+// USDT静态探针，provider为tinyweb，bpftrace中写成usdt:tinyweb:探针名。
+// 探针编译成一条nop，没有被附加时不产生开销；参数只用已经算好的值，不要为了探针去拷贝或者格式化。
+// 没有sys/sdt.h(systemtap-sdt-dev)或者定义了TINYWEB_NO_PROBES时探针为空，参数也不会求值
+#if !defined(TINYWEB_NO_PROBES) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define TINYWEB_HAS_PROBES 1
+#endif
+#endif
+
+#ifdef TINYWEB_HAS_PROBES
+#define TW_PROBE0(name)                 STAP_PROBE(tinyweb, name)
+#define TW_PROBE1(name, a)              STAP_PROBE1(tinyweb, name, a)
+#define TW_PROBE2(name, a, b)           STAP_PROBE2(tinyweb, name, a, b)
+#define TW_PROBE3(name, a, b, c)        STAP_PROBE3(tinyweb, name, a, b, c)
+#else
+#define TW_PROBE0(name)                 do{}while(0)
+#define TW_PROBE1(name, a)              do{}while(0)
+#define TW_PROBE2(name, a, b)           do{}while(0)
+#define TW_PROBE3(name, a, b, c)        do{}while(0)
+#endif
+
+#endif
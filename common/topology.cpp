@@ -0,0 +1,123 @@
+#include "topology.h"
+#include <cstdio>
+#include <cstdlib>
+#include <dirent.h>
+#include <fstream>
+#include <sched.h>
+#include <unistd.h>
+
+std::string Topology::ReadLine(const std::string& file){
+    std::ifstream in(file);
+    std::string line;
+    std::getline(in, line);
+    return line;
+}
+
+int Topology::CpuCount(){
+    long num = sysconf(_SC_NPROCESSORS_ONLN);
+    return num > 0 ? (int)num : 1;
+}
+
+int Topology::NodeCount(){
+    std::vector<int> nodes = ParseList(ReadLine("/sys/devices/system/node/online"), -1);
+    return nodes.empty() ? 1 : nodes.back() + 1;
+}
+
+// cpuN目录下有一个nodeM的链接指向所属节点
+int Topology::NodeOfCpu(int cpu){
+    std::string path = "/sys/devices/system/cpu/cpu" + std::to_string(cpu);
+    DIR* dir = opendir(path.c_str());
+    if(!dir)
+        return 0;
+    int node = 0;
+    struct dirent* ent;
+    while((ent = readdir(dir)) != nullptr){
+        int id;
+        if(sscanf(ent->d_name, "node%d", &id) == 1){
+            node = id;
+            break;
+        }
+    }
+    closedir(dir);
+    return node;
+}
+
+std::vector<int> Topology::NodeCpus(int node){
+    std::string list = ReadLine("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+    if(list.empty()){
+        std::vector<int> cpus;
+        if(node == 0){
+            for(int i = 0; i < CpuCount(); ++i)
+                cpus.push_back(i);
+        }
+        return cpus;
+    }
+    return ParseCpuList(list);
+}
+
+std::vector<int> Topology::ParseCpuList(const std::string& list){
+    return ParseList(list, CpuCount());
+}
+
+// limit小于0时不过滤
+std::vector<int> Topology::ParseList(const std::string& list, int limit){
+    std::vector<int> ids;
+    std::size_t pos = 0;
+    while(pos < list.size()){
+        std::size_t end = list.find(',', pos);
+        if(end == std::string::npos)
+            end = list.size();
+        std::string item = list.substr(pos, end - pos);
+        pos = end + 1;
+        if(item.empty())
+            continue;
+
+        int first = atoi(item.c_str());
+        int last = first;
+        std::size_t dash = item.find('-');
+        if(dash != std::string::npos)
+            last = atoi(item.c_str() + dash + 1);
+        for(int id = first; id <= last; ++id){
+            if(id >= 0 && (limit < 0 || id < limit))
+                ids.push_back(id);
+        }
+    }
+    return ids;
+}
+
+std::string Topology::FormatCpuList(const std::vector<int>& cpus){
+    std::string res;
+    std::size_t i = 0;
+    while(i < cpus.size()){
+        std::size_t j = i;
+        while(j + 1 < cpus.size() && cpus[j + 1] == cpus[j] + 1)
+            ++j;
+        if(!res.empty())
+            res += ",";
+        res += std::to_string(cpus[i]);
+        if(j > i)
+            res += "-" + std::to_string(cpus[j]);
+        i = j + 1;
+    }
+    return res;
+}
+
+bool Topology::PinThread(pthread_t thread, int cpu){
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(cpu, &cpus);
+    return pthread_setaffinity_np(thread, sizeof(cpus), &cpus) == 0;
+}
+
+// 例如"2 cpus, 1 numa nodes, node0: 0-1"
+std::string Topology::Report(){
+    int nodes = NodeCount();
+    std::string res = std::to_string(CpuCount()) + " cpus, " + std::to_string(nodes) + " numa nodes";
+    for(int node = 0; node < nodes; ++node){
+        std::vector<int> cpus = NodeCpus(node);
+        if(cpus.empty())
+            continue;
+        res += ", node" + std::to_string(node) + ": " + FormatCpuList(cpus);
+    }
+    return res;
+}
@@ -0,0 +1,24 @@
+#ifndef TOPOLOGY_H
+#define TOPOLOGY_H
+#include <pthread.h>
+#include <string>
+#include <vector>
+
+// CPU和NUMA拓扑，从/sys/devices/system读取，没有NUMA信息时所有CPU都算在节点0
+class Topology{
+public:
+    static int CpuCount();
+    static int NodeCount();
+    static int NodeOfCpu(int cpu);
+    static std::vector<int> NodeCpus(int node);
+    static std::vector<int> ParseCpuList(const std::string& list);      // 解析"0-3,8"这种格式，忽略不在线的CPU
+    static std::string FormatCpuList(const std::vector<int>& cpus);
+    static bool PinThread(pthread_t thread, int cpu);
+    static std::string Report();
+
+private:
+    static std::string ReadLine(const std::string& file);
+    static std::vector<int> ParseList(const std::string& list, int limit);
+};
+
+#endif
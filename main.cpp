@@ -6,10 +6,12 @@
 #include <iostream>
 #include <thread>
 #include <cstdio>
+#include <cstdlib>
 #include <unistd.h>
+#include <cstring>
 #include "Combine/webserver.h"
 
-int main(){
+int main(int argc, char* argv[]){
     #if _BUFFER_TEST
     std::cout << "----------------Buffer Test--------------------"<<std::endl;
     Buffer buffer;
@@ -101,9 +103,71 @@ int main(){
 
     #endif
 
-    WebServer server{1316,3,60000, 
+    ServerOptions options;
+    options.register_write_behind = false;
+    options.user_filter = false;
+    options.session = false;
+    options.file_cache = false;
+    options.inline_static = false;
+    options.metrics = false;            // /metrics没有认证，和页面共用端口，需要时用-M打开
+    options.trace_sample_n = 100;
+    options.trace_slow_ms = 50;
+    options.listen_backlog = 1024;
+    options.header_timeout_ms = 10000;
+    options.body_timeout_ms = 30000;
+    options.write_timeout_ms = 30000;
+    options.max_keep_alive_requests = 100;
+    options.max_header_bytes = 8 * 1024;
+    options.max_body_bytes = 1024 * 1024;
+    options.io_budget_bytes = 256 * 1024;
+
+    // -b epoll|uring 选择I/O后端，-i 事件循环线程直接处理命中缓存的静态请求，-t 开启TCP参数调优，-m 触发模式0~3，-p 忙轮询微秒数，-c 事件循环绑定的CPU(工作线程绑定同一节点的其他CPU)，-M 开启/metrics，-T 开启请求追踪(/debug/trace)，-C 把请求抓到文件
+    int trig_mode = 3;
+    int opt;
+    while((opt = getopt(argc, argv, "b:c:C:itm:Mp:T")) != -1){
+        switch (opt) {
+            case 'b':
+                options.io_backend = strcmp(optarg, "uring") == 0 ? BACKEND_URING : BACKEND_EPOLL;
+                break;
+            case 'c':
+                options.loop_cpu = atoi(optarg);
+                options.worker_cpus = "node";
+                break;
+            case 'C':
+                options.capture_file = optarg;
+                break;
+            case 'i':
+                options.inline_static = true;
+                break;
+            case 'p':
+                options.busy_poll_us = atoi(optarg);
+                options.so_busy_poll_us = 50;
+                options.loop_cpu = 0;
+                break;
+            case 'm':
+                trig_mode = atoi(optarg);
+                break;
+            case 'M':
+                options.metrics = true;
+                break;
+            case 'T':
+                options.trace = true;
+                break;
+            case 't':
+                options.tcp_nodelay = true;
+                options.tcp_cork = true;
+                options.defer_accept_s = 5;
+                options.fastopen_qlen = 256;
+                break;
+            default:
+                break;
+        }
+    }
+
+    WebServer server{1316,trig_mode,60000, 
                 true, 3306, 
-                "root","334859","webserver",12,true, 1, 1024};
+                "root","334859","webserver",12,true, 1, 1024,
+                options};
     server.Start();
 
     return 0;